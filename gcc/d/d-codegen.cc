@@ -1591,6 +1591,45 @@ build_vindex_ref(tree object, tree fntype, size_t index)
   return build_memref(fntype, result, size_int(Target::ptrsize * index));
 }
 
+// Return the function that a virtual call to FD on OBJECT reaches, if the
+// dynamic type of OBJECT is known at compile time.  That is the case when
+// the static type of OBJECT is a final class, or when OBJECT is the class
+// instance just created by a new expression.  Returns NULL if the call has
+// to go through the vtable.
+
+FuncDeclaration *
+resolve_virtual_call (FuncDeclaration *fd, Expression *object)
+{
+  Type *tb = object->type->toBasetype ();
+  if (tb->ty != Tclass)
+    return NULL;
+
+  ClassDeclaration *cd = ((TypeClass *) tb)->sym;
+  if (cd->isInterfaceDeclaration ())
+    return NULL;
+
+  if (!(cd->storage_class & STCfinal) && object->op != TOKnew)
+    return NULL;
+
+  // Interface methods are indexed into the interface vtable.
+  AggregateDeclaration *ad = fd->isThis ();
+  ClassDeclaration *fcd = ad ? ad->isClassDeclaration () : NULL;
+  if (!fcd || fcd->isInterfaceDeclaration ())
+    return NULL;
+
+  if (fcd != cd && !fcd->isBaseOf (cd, NULL))
+    return NULL;
+
+  if (fd->vtblIndex < 0 || (size_t) fd->vtblIndex >= cd->vtbl.dim)
+    return NULL;
+
+  FuncDeclaration *target = cd->vtbl[fd->vtblIndex]->isFuncDeclaration ();
+  if (!target || target->isAbstract ())
+    return NULL;
+
+  return target;
+}
+
 // Builds a record type from field types T1 and T2.  TYPE is the D frontend
 // type we are building. N1 and N2 are the names of the two fields.
 
@@ -2034,6 +2073,143 @@ build_struct_comparison(tree_code code, StructDeclaration *sd, tree t1, tree t2)
   return compound_expr(compound_expr(t1init, t2init), result);
 }
 
+// Build a three-way comparison of the scalars T1 and T2 of type TYPE,
+// returning the same result as TypeInfo.compare.  For floating point types,
+// NaN compares less than any other value, and equal to itself.
+
+static tree
+build_scalar_compare(Type *type, tree t1, tree t2)
+{
+  tree inttype = build_ctype(Type::tint32);
+  tree lt = build_boolop(LT_EXPR, t1, t2);
+  tree gt = build_boolop(GT_EXPR, t1, t2);
+
+  if (!type->isfloating())
+    {
+      //	(t1 > t2) - (t1 < t2)
+      return fold_build2(MINUS_EXPR, inttype, convert(inttype, gt),
+			 convert(inttype, lt));
+    }
+
+  //	t1 < t2 ? -1 : t1 > t2 ? 1 : t1 == t2 ? 0
+  //	  : t1 is nan ? (t2 is nan ? 0 : -1) : 1
+  tree minus_one = build_int_cst(inttype, -1);
+  tree one = build_int_cst(inttype, 1);
+  tree zero = build_int_cst(inttype, 0);
+
+  tree t1nan = build_boolop(UNORDERED_EXPR, t1, t1);
+  tree t2nan = build_boolop(UNORDERED_EXPR, t2, t2);
+  tree result = fold_build3(COND_EXPR, inttype, t1nan,
+			    fold_build3(COND_EXPR, inttype, t2nan,
+					zero, minus_one), one);
+  result = fold_build3(COND_EXPR, inttype, build_boolop(EQ_EXPR, t1, t2),
+		       zero, result);
+  result = fold_build3(COND_EXPR, inttype, gt, one, result);
+  return fold_build3(COND_EXPR, inttype, lt, minus_one, result);
+}
+
+// Build a three-way comparison of the dynamic arrays T1 and T2, whose
+// elements are of type TELEM.  The result has the same sign as what
+// TypeInfo_Array.compare would return: the first mismatching elements are
+// compared, and if there are none, the lengths are compared.
+// Returns NULL_TREE if TELEM can't be compared inline.
+
+tree
+build_array_compare(Type *telem, tree t1, tree t2)
+{
+  // Arrays of unsigned bytes compare the same as memcmp.
+  bool bytes_p = (telem->ty == Tuns8 || telem->ty == Tchar
+		  || telem->ty == Tbool || telem->ty == Tvoid);
+
+  if (!bytes_p)
+    {
+      // Other integral and real types are compared in a loop.
+      if (!(telem->isTypeBasic() && (telem->isintegral() || telem->isreal())))
+	return NULL_TREE;
+
+      if (optimize_size)
+	return NULL_TREE;
+    }
+
+  tree inttype = build_ctype(Type::tint32);
+  tree t1len = d_array_length(t1);
+  tree t2len = d_array_length(t2);
+  tree result = build_local_temp(inttype);
+
+  push_binding_level(level_block);
+  push_stmt_list();
+
+  // Build temporary local for the length of the common prefix.
+  tree length = build_local_temp(size_type_node);
+  add_stmt(build_assign(INIT_EXPR, length,
+			fold_build2(MIN_EXPR, size_type_node, t1len, t2len)));
+
+  if (bytes_p)
+    {
+      //	result = length ? memcmp(t1.ptr, t2.ptr, length) : 0
+      tree tmemcmp = d_build_call_nary(builtin_decl_explicit(BUILT_IN_MEMCMP), 3,
+				       d_array_ptr(t1), d_array_ptr(t2), length);
+      tree t = build3(COND_EXPR, inttype,
+		      build_boolop(NE_EXPR, length, size_zero_node),
+		      convert(inttype, tmemcmp), build_int_cst(inttype, 0));
+      add_stmt(build_assign(INIT_EXPR, result, t));
+    }
+  else
+    {
+      add_stmt(build_assign(INIT_EXPR, result, build_int_cst(inttype, 0)));
+
+      // Build temporary locals for the pointers.
+      tree ptrtype = build_ctype(telem->pointerTo());
+      tree p1 = build_local_temp(ptrtype);
+      add_stmt(build_assign(INIT_EXPR, p1, d_convert(ptrtype, d_array_ptr(t1))));
+      tree p2 = build_local_temp(ptrtype);
+      add_stmt(build_assign(INIT_EXPR, p2, d_convert(ptrtype, d_array_ptr(t2))));
+
+      // Build loop for comparing each element.
+      push_stmt_list();
+
+      // Exit logic for the loop.
+      //	if (length == 0) break
+      tree t = build_boolop(EQ_EXPR, length, size_zero_node);
+      add_stmt(build1(EXIT_EXPR, void_type_node, t));
+
+      // Compare the elements, stopping at the first mismatch.
+      //	result = cmp(*p1, *p2); if (result != 0) break
+      t = build_scalar_compare(telem, build_deref(p1), build_deref(p2));
+      add_stmt(modify_expr(result, t));
+      t = build_boolop(NE_EXPR, result, build_int_cst(inttype, 0));
+      add_stmt(build1(EXIT_EXPR, void_type_node, t));
+
+      // Move both pointers to next element position.
+      //	p1++, p2++, length -= 1
+      tree size = d_convert(ptrtype, TYPE_SIZE_UNIT (TREE_TYPE (ptrtype)));
+      add_stmt(build2(POSTINCREMENT_EXPR, ptrtype, p1, size));
+      add_stmt(build2(POSTINCREMENT_EXPR, ptrtype, p2, size));
+      add_stmt(build2(POSTDECREMENT_EXPR, size_type_node, length,
+		      size_one_node));
+
+      // Pop statements and finish loop.
+      tree body = pop_stmt_list();
+      add_stmt(build1(LOOP_EXPR, void_type_node, body));
+    }
+
+  // Wrap it up into a bind expression.
+  tree stmt_list = pop_stmt_list();
+  tree block = pop_binding_level();
+
+  tree body = build3(BIND_EXPR, void_type_node,
+		     BLOCK_VARS (block), stmt_list, block);
+
+  // If the common prefix is the same, the shorter array is less.
+  //	result ? result : (t1.length > t2.length) - (t1.length < t2.length)
+  tree lencmp = build_scalar_compare(Type::tsize_t, t1len, t2len);
+  result = build3(COND_EXPR, inttype,
+		  build_boolop(NE_EXPR, result, build_int_cst(inttype, 0)),
+		  result, lencmp);
+
+  return compound_expr(body, result);
+}
+
 // Build an equality expression between two ARRAY_TYPES of size LENGTH.
 // The pointer references are T1 and T2, and the element type is SD.
 // CODE is the EQ_EXPR or NE_EXPR comparison.
@@ -2788,6 +2964,138 @@ build_array_set(tree ptr, tree length, tree value)
 }
 
 
+// Build the hash of the string STR, the same way as TypeInfo_Aa.getHash.
+//	hash = 0; foreach (c; str) hash = hash * 11 + c;
+
+static tree
+build_string_hash(tree str)
+{
+  tree hash = build_local_temp(size_type_node);
+  tree init = build_assign(INIT_EXPR, hash, size_int(0));
+
+  push_binding_level(level_block);
+  push_stmt_list();
+
+  // Build temporary locals for length and ptr.
+  tree length = build_local_temp(size_type_node);
+  add_stmt(build_assign(INIT_EXPR, length, d_array_length(str)));
+
+  tree ptr = d_array_ptr(str);
+  tree ptrtype = TREE_TYPE (ptr);
+  tree t = build_local_temp(ptrtype);
+  add_stmt(build_assign(INIT_EXPR, t, ptr));
+  ptr = t;
+
+  // Build loop for hashing each character.
+  push_stmt_list();
+
+  // Exit logic for the loop.
+  //	if (length == 0) break
+  t = build_boolop(EQ_EXPR, length, size_int(0));
+  t = build1(EXIT_EXPR, void_type_node, t);
+  add_stmt(t);
+
+  //	hash = hash * 11 + *ptr
+  t = fold_build2(MULT_EXPR, size_type_node, hash, size_int(11));
+  t = fold_build2(PLUS_EXPR, size_type_node, t,
+		  convert(size_type_node, build_deref(ptr)));
+  add_stmt(modify_expr(hash, t));
+
+  //	ptr++, length -= 1
+  tree size = TYPE_SIZE_UNIT (TREE_TYPE (ptrtype));
+  t = build2(POSTINCREMENT_EXPR, ptrtype, ptr, d_convert(ptrtype, size));
+  add_stmt(t);
+  t = build2(POSTDECREMENT_EXPR, size_type_node, length, size_int(1));
+  add_stmt(t);
+
+  // Pop statements and finish loop.
+  tree loop_body = pop_stmt_list();
+  add_stmt(build1(LOOP_EXPR, void_type_node, loop_body));
+
+  // Wrap it up into a bind expression.
+  tree stmt_list = pop_stmt_list();
+  tree block = pop_binding_level();
+
+  tree body = build3(BIND_EXPR, void_type_node,
+		     BLOCK_VARS (block), stmt_list, block);
+
+  return compound_expr(compound_expr(init, body), hash);
+}
+
+// Build the hash of KEY, the lvalue of an associative array key of type TKEY,
+// the same way as TypeInfo.getHash would compute it.  The runtime function
+// used to compare two keys of type TKEY is returned in EQUALS.
+// Returns NULL_TREE if there is no inline sequence for TKEY.
+
+tree
+build_aa_key_hash(Type *tkey, tree key, LibCall *equals)
+{
+  Type *tb = tkey->toBasetype();
+
+  // Keys whose TypeInfo is not the builtin one may hash differently.
+  if (tb->mod & (MODshared | MODwild))
+    return NULL_TREE;
+
+  if (tb->ty == Tpointer)
+    {
+      // TypeInfo_Pointer hashes the address.
+      *equals = (tb->size() == 8) ? LIBCALL_AAKEYEQUALS8 : LIBCALL_AAKEYEQUALS4;
+      return convert(size_type_node, key);
+    }
+
+  if (tb->isTypeBasic() && tb->isintegral())
+    {
+      switch (tb->size())
+	{
+	case 1:
+	  *equals = LIBCALL_AAKEYEQUALS1;
+	  break;
+
+	case 2:
+	  *equals = LIBCALL_AAKEYEQUALS2;
+	  break;
+
+	case 4:
+	  *equals = LIBCALL_AAKEYEQUALS4;
+	  // TypeInfo_i.getHash reads the key as a uint, so int keys are
+	  // zero-extended, unlike byte and short keys.
+	  if (!tb->isunsigned())
+	    key = convert(d_unsigned_type(TREE_TYPE (key)), key);
+	  break;
+
+	case 8:
+	  // 64-bit integers are hashed with rt.util.hash.hashOf.
+	  *equals = LIBCALL_AAKEYEQUALS8;
+	  {
+	    tree args[2];
+	    args[0] = build_address(key);
+	    args[1] = size_int(8);
+	    return build_libcall(LIBCALL_AAHASHOF, 2, args);
+	  }
+
+	default:
+	  return NULL_TREE;
+	}
+
+      // The hash of smaller integers is their value.
+      return convert(size_type_node, key);
+    }
+
+  if (tb->ty == Tarray)
+    {
+      Type *tnext = tb->nextOf();
+      if (tnext->ty == Tchar
+	  && (tnext->mod == 0 || tnext->mod == MODconst
+	      || tnext->mod == MODimmutable))
+	{
+	  *equals = LIBCALL_AAKEYEQUALSSTRING;
+	  return build_string_hash(key);
+	}
+    }
+
+  return NULL_TREE;
+}
+
 // Build an array of type TYPE where all the elements are VAL.
 
 tree
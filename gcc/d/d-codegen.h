@@ -49,6 +49,7 @@ extern tree build_address (tree exp);
 extern bool identity_compare_p(StructDeclaration *sd);
 extern tree build_struct_comparison(tree_code code, StructDeclaration *sd, tree t1, tree t2);
 extern tree build_array_struct_comparison(tree_code code, StructDeclaration *sd, tree length, tree t1, tree t2);
+extern tree build_array_compare(Type *telem, tree t1, tree t2);
 extern tree build_struct_literal(tree type, vec<constructor_elt, va_gc> *init);
 extern tree build_class_instance(ClassReferenceExp *exp);
 
@@ -116,6 +117,7 @@ extern tree build_offset_op (tree_code op, tree ptr, tree idx);
 extern tree build_offset (tree ptr_node, tree byte_offset);
 extern tree build_memref (tree type, tree ptr, tree byte_offset);
 extern tree build_array_set(tree ptr, tree length, tree value);
+extern tree build_aa_key_hash(Type *tkey, tree key, LibCall *equals);
 extern tree build_array_from_val(Type *type, tree val);
 
 // Function calls
@@ -168,6 +170,7 @@ extern tree build_delegate_cst (tree method, tree object, Type *type);
 extern tree build_method_call (tree callee, tree object, Type *type);
 extern void extract_from_method_call (tree t, tree& callee, tree& object);
 extern tree build_vindex_ref (tree object, tree fndecl, size_t index);
+extern FuncDeclaration *resolve_virtual_call (FuncDeclaration *fd, Expression *object);
 
 // Built-in and Library functions.
 extern FuncDeclaration *get_libcall (LibCall libcall);
@@ -302,11 +302,22 @@ get_symbol_decl (Declaration *decl)
 	  DECL_UNINLINABLE (decl->csym) = 1;
 	}
 
-      /* Vector array operations are always compiler generated.  */
+      /* Vector array operations are always compiler generated.  The front
+	 end caches them by name and emits each once, in the first module that
+	 needs it, so they must stay public for the other modules to call.
+	 When they are expanded inline, the loop is optimized with the
+	 operands of each use in view.  */
       if (fd->isArrayOp)
 	{
 	  DECL_ARTIFICIAL (decl->csym) = 1;
 	  D_DECL_ONE_ONLY (decl->csym) = 1;
+
+	  if (flag_inline_array_ops)
+	    {
+	      DECL_DECLARED_INLINE_P (decl->csym) = 1;
+	      DECL_DISREGARD_INLINE_LIMITS (decl->csym) = 1;
+	      DECL_NO_INLINE_WARNING_P (decl->csym) = 1;
+	    }
 	}
 
       /* And so are ensure and require contracts.  */
@@ -134,6 +134,129 @@ Loc::equals(const Loc& loc)
 }
 
 
+// Diagnostics raised while modules are parsed on other threads can't go
+// through the GCC diagnostic machinery.  They are kept here instead, and
+// emitted by the main thread in the same order as a serial parse would.
+
+enum deferred_kind
+{
+  DEFERRED_error,
+  DEFERRED_errorSupplemental,
+  DEFERRED_warning,
+  DEFERRED_warningSupplemental,
+  DEFERRED_deprecation,
+  DEFERRED_deprecationSupplemental
+};
+
+struct deferred_diagnostic
+{
+  deferred_kind kind;
+  Loc loc;
+  char *msg;
+};
+
+struct deferred_diagnostics
+{
+  Array<deferred_diagnostic *> list;
+};
+
+static THREAD_LOCAL deferred_diagnostics *current_deferred;
+
+// Start recording all diagnostics raised by this thread.
+
+deferred_diagnostics *
+start_deferred_diagnostics()
+{
+  current_deferred = new deferred_diagnostics;
+  return current_deferred;
+}
+
+void
+stop_deferred_diagnostics()
+{
+  current_deferred = NULL;
+}
+
+// Record the diagnostic if this thread is deferring them.
+// Returns true if the diagnostic was recorded.
+
+static bool
+defer_diagnostic(deferred_kind kind, const Loc& loc, const char *format,
+		 va_list ap, const char *p1 = NULL, const char *p2 = NULL)
+{
+  if (!current_deferred)
+    return false;
+
+  char *msg;
+  if (vasprintf(&msg, format, ap) >= 0 && msg != NULL)
+    {
+      if (p2)
+	msg = concat(p2, " ", msg, NULL);
+
+      if (p1)
+	msg = concat(p1, " ", msg, NULL);
+
+      deferred_diagnostic *dd = new deferred_diagnostic;
+      dd->kind = kind;
+      dd->loc = loc;
+      dd->msg = msg;
+      current_deferred->list.push(dd);
+    }
+  return true;
+}
+
+// Emit the diagnostics recorded in DIAGS, as if they were raised now.
+
+void
+emit_deferred_diagnostics(deferred_diagnostics *diags)
+{
+  if (!diags)
+    return;
+
+  for (size_t i = 0; i < diags->list.dim; i++)
+    {
+      deferred_diagnostic *dd = diags->list[i];
+
+      switch (dd->kind)
+	{
+	case DEFERRED_error:
+	  error(dd->loc, "%s", dd->msg);
+	  break;
+
+	case DEFERRED_errorSupplemental:
+	  errorSupplemental(dd->loc, "%s", dd->msg);
+	  break;
+
+	case DEFERRED_warning:
+	  warning(dd->loc, "%s", dd->msg);
+	  break;
+
+	case DEFERRED_warningSupplemental:
+	  warningSupplemental(dd->loc, "%s", dd->msg);
+	  break;
+
+	case DEFERRED_deprecation:
+	  deprecation(dd->loc, "%s", dd->msg);
+	  break;
+
+	case DEFERRED_deprecationSupplemental:
+	  deprecationSupplemental(dd->loc, "%s", dd->msg);
+	  break;
+
+	default:
+	  gcc_unreachable();
+	}
+    }
+}
+
+// Returns true if a diagnostic raised now would not be printed.
+
+bool
+Global::diagnosticsGagged()
+{
+  return this->gag && !this->params.showGaggedErrors && !current_deferred;
+}
+
 // Print a hard error message.
 
 void
@@ -149,6 +272,9 @@ void
 verror(const Loc& loc, const char *format, va_list ap,
        const char *p1, const char *p2, const char *)
 {
+  if (defer_diagnostic(DEFERRED_error, loc, format, ap, p1, p2))
+    return;
+
   if (!global.gag || global.params.showGaggedErrors)
     {
       location_t location = get_linemap(loc);
@@ -192,6 +318,9 @@ errorSupplemental(const Loc& loc, const char *format, ...)
 void
 verrorSupplemental(const Loc& loc, const char *format, va_list ap)
 {
+  if (defer_diagnostic(DEFERRED_errorSupplemental, loc, format, ap))
+    return;
+
   if (global.gag && !global.params.showGaggedErrors)
     return;
 
@@ -216,6 +345,9 @@ warning(const Loc& loc, const char *format, ...)
 void
 vwarning(const Loc& loc, const char *format, va_list ap)
 {
+  if (defer_diagnostic(DEFERRED_warning, loc, format, ap))
+    return;
+
   if (global.params.warnings && !global.gag)
     {
       location_t location = get_linemap(loc);
@@ -245,6 +377,9 @@ warningSupplemental(const Loc& loc, const char *format, ...)
 void
 vwarningSupplemental(const Loc& loc, const char *format, va_list ap)
 {
+  if (defer_diagnostic(DEFERRED_warningSupplemental, loc, format, ap))
+    return;
+
   if (global.params.warnings && !global.gag)
     {
       location_t location = get_linemap(loc);
@@ -270,6 +405,9 @@ void
 vdeprecation(const Loc& loc, const char *format, va_list ap,
 	      const char *p1, const char *p2)
 {
+  if (defer_diagnostic(DEFERRED_deprecation, loc, format, ap, p1, p2))
+    return;
+
   if (global.params.useDeprecated == 0)
     verror(loc, format, ap, p1, p2);
   else if (global.params.useDeprecated == 2 && !global.gag)
@@ -303,6 +441,9 @@ deprecationSupplemental(const Loc& loc, const char *format, ...)
 void
 vdeprecationSupplemental(const Loc& loc, const char *format, va_list ap)
 {
+  if (defer_diagnostic(DEFERRED_deprecationSupplemental, loc, format, ap))
+    return;
+
   if (global.params.useDeprecated == 0)
     verrorSupplemental(loc, format, ap);
   else if (global.params.useDeprecated == 2 && !global.gag)
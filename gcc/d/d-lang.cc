@@ -25,6 +25,7 @@
 #include "dfrontend/mtype.h"
 #include "dfrontend/aggregate.h"
 #include "dfrontend/cond.h"
+#include "dfrontend/ctfe.h"
 #include "dfrontend/hdrgen.h"
 #include "dfrontend/doc.h"
 #include "dfrontend/json.h"
@@ -34,6 +35,8 @@
 #include "dfrontend/statement.h"
 #include "dfrontend/root.h"
 #include "dfrontend/target.h"
+#include "dfrontend/template.h"
+#include "dfrontend/timetrace.h"
 
 #include "opts.h"
 #include "alias.h"
@@ -48,6 +51,10 @@
 #include "stringpool.h"
 #include "stor-layout.h"
 #include "print-tree.h"
+
+#ifdef HAVE_D_PTHREAD
+#include <pthread.h>
+#endif
 #include "gimple-expr.h"
 #include "gimplify.h"
 #include "debug.h"
@@ -148,6 +155,8 @@ struct d_option_data
   bool deps_phony;                  /* -MP  */
 
   bool stdinc;                      /* -nostdinc  */
+
+  unsigned parse_threads;           /* -fparse-threads=<number>  */
 }
 d_option;
 
@@ -338,6 +347,8 @@ d_init_options(unsigned int, cl_decoded_option *decoded_options)
   global.params.useIn = true;
   global.params.useOut = true;
   global.params.useArrayBounds = BOUNDSCHECKdefault;
+  global.params.ctfeEngine = CTFEENGINEast;
+  global.params.timeTraceGranularity = 500;
   global.params.useSwitchError = true;
   global.params.useInline = false;
   global.params.warnings = 0;
@@ -554,6 +565,15 @@ d_handle_option (size_t scode, const char *arg, int value,
 	: (value == 1) ? BOUNDSCHECKsafeonly : BOUNDSCHECKoff;
       break;
 
+    case OPT_fctfe_engine_:
+      global.params.ctfeEngine = (value == 1) ? CTFEENGINEbytecode
+	: CTFEENGINEast;
+      break;
+
+    case OPT_fd_arena:
+      Mem::arena = value;
+      break;
+
     case OPT_fdebug:
       global.params.debuglevel = value ? 1 : 0;
       break;
@@ -633,6 +653,10 @@ d_handle_option (size_t scode, const char *arg, int value,
       global.params.useInvariants = value;
       break;
 
+    case OPT_fmodule_cache_:
+      global.params.moduleCacheDir = arg;
+      break;
+
     case OPT_fmodule_filepath_:
       global.params.modFileAliasStrings->push (arg);
       if (!strchr (arg, '='))
@@ -647,6 +671,10 @@ d_handle_option (size_t scode, const char *arg, int value,
       d_option.fonly = arg;
       break;
 
+    case OPT_fparse_threads_:
+      d_option.parse_threads = value;
+      break;
+
     case OPT_fpostconditions:
       global.params.useOut = value;
       break;
@@ -667,6 +695,21 @@ d_handle_option (size_t scode, const char *arg, int value,
       global.params.useSwitchError = value;
       break;
 
+    case OPT_ftime_trace:
+      global.params.timeTrace = value;
+      break;
+
+    case OPT_ftime_trace_:
+      global.params.timeTrace = true;
+      global.params.timeTraceFile = arg;
+      if (!global.params.timeTraceFile[0])
+	error ("bad argument for -ftime-trace");
+      break;
+
+    case OPT_ftime_trace_granularity_:
+      global.params.timeTraceGranularity = value;
+      break;
+
     case OPT_ftransition_all:
       global.params.vtls = value;
       global.params.vfield = value;
@@ -795,6 +838,12 @@ d_handle_option (size_t scode, const char *arg, int value,
 	global.params.warnings = 2;
       break;
 
+    case OPT_Wctfe_fallback:
+      global.params.warnCtfeFallback = value;
+      if (value && !global.params.warnings)
+	global.params.warnings = 2;
+      break;
+
     case OPT_Wdeprecated:
       global.params.useDeprecated = value ? 2 : 1;
       break;
@@ -889,6 +938,10 @@ d_post_options (const char ** fn)
   if (global.params.useUnitTests)
     global.params.useAssert = true;
 
+  // Array operations are expanded inline when optimizing for speed.
+  if (flag_inline_array_ops < 0)
+    flag_inline_array_ops = optimize && !optimize_size;
+
   global.params.symdebug = write_symbols != NO_DEBUG;
   global.params.useInline = flag_inline_functions;
 
@@ -1052,6 +1105,215 @@ genCmain (Scope *sc)
   rootmodule = sc->_module;
 }
 
+/* Modules given on the command line, parsed by several threads at once
+   with -fparse-threads.  */
+
+struct d_parse_queue
+{
+  Modules *modules;
+  deferred_diagnostics **diagnostics;
+  size_t next;
+};
+
+/* Take modules from QUEUE and parse them until there are none left.
+   Diagnostics are recorded for the main thread to emit in order.  */
+
+static void
+d_parse_modules (d_parse_queue *queue)
+{
+  Identifier::threadtable = new StringTable ();
+  Identifier::threadtable->_init ();
+
+  while (1)
+    {
+      size_t i = __sync_fetch_and_add (&queue->next, 1);
+      if (i >= queue->modules->dim)
+	break;
+
+      Module *m = (*queue->modules)[i];
+      if (!m->canParseInThread ())
+	continue;
+
+      queue->diagnostics[i] = start_deferred_diagnostics ();
+      Identifier::beginParseUnit (i + 1);
+      m->parseSource ();
+      Identifier::beginParseUnit (0);
+      stop_deferred_diagnostics ();
+    }
+
+  Identifier::threadtable = NULL;
+}
+
+#ifdef HAVE_D_PTHREAD
+static void *
+d_parse_thread (void *data)
+{
+  d_parse_modules ((d_parse_queue *) data);
+  Mem::threadDone ();
+  return NULL;
+}
+#endif
+
+/* Parse the source of MODULES using NTHREADS threads, including the
+   current one.  Anything that can't be done on a thread is left for
+   Module::parse, and DIAGNOSTICS[I] is set to what was raised while
+   parsing MODULES[I].  */
+
+static void
+d_parse_modules_parallel (Modules *modules, deferred_diagnostics **diagnostics,
+			  unsigned nthreads)
+{
+  d_parse_queue queue;
+  queue.modules = modules;
+  queue.diagnostics = diagnostics;
+  queue.next = 0;
+
+#ifdef HAVE_D_PTHREAD
+  if (nthreads > modules->dim)
+    nthreads = modules->dim;
+
+  pthread_t *threads = XNEWVEC (pthread_t, nthreads);
+  unsigned started = 0;
+
+  for (unsigned i = 1; i < nthreads; i++)
+    {
+      /* If threads can't be created, the rest is done on this one.  */
+      if (pthread_create (&threads[started], NULL, d_parse_thread, &queue))
+	break;
+      started++;
+    }
+
+  d_parse_modules (&queue);
+
+  for (unsigned i = 0; i < started; i++)
+    pthread_join (threads[i], NULL);
+
+  XDELETEVEC (threads);
+#else
+  /* Built without threads, so all of it is done on this one.  */
+  (void) nthreads;
+  d_parse_modules (&queue);
+#endif
+}
+
+/* Defined in dfrontend/inline.c.  */
+extern bool canInline (FuncDeclaration *, int, int, bool);
+
+/* Return true if the body of FD, a function from an imported module, is
+   small enough to be worth compiling so that it can be inlined.  */
+
+static bool
+d_cross_module_inline_p (FuncDeclaration *fd)
+{
+  if (!fd->fbody || fd->semanticRun < PASSsemanticdone)
+    return false;
+
+  /* Templates are already compiled wherever they are used.  */
+  if (fd->isInstantiated () || fd->isNested () || fd->isArrayOp)
+    return false;
+
+  if (fd->isUnitTestDeclaration () || fd->isStaticCtorDeclaration ()
+      || fd->isStaticDtorDeclaration () || fd->isFuncLiteralDeclaration ()
+      || fd->isMain ())
+    return false;
+
+  if (fd->naked || fd->builtin == BUILTINyes || fd->isSynchronized ()
+      || (fd->isVirtual () && !fd->isFinalFunc ()))
+    return false;
+
+  /* Use the same cost estimate as the front-end inliner does when scanning
+     bodies for header generation, as semantic has not been ran yet.  */
+  return canInline (fd, 1, 1, true);
+}
+
+/* Add all functions in MEMBERS that can be inlined across modules to
+   CANDIDATES, looking inside attributes and aggregates.  */
+
+static void
+d_collect_inline_candidates (Dsymbols *members, FuncDeclarations *candidates)
+{
+  for (size_t i = 0; i < members->dim; i++)
+    {
+      Dsymbol *s = (*members)[i];
+
+      if (AttribDeclaration *attrib = s->isAttribDeclaration ())
+	{
+	  Dsymbols *decls = attrib->include (NULL, NULL);
+	  if (decls)
+	    d_collect_inline_candidates (decls, candidates);
+	}
+      else if (AggregateDeclaration *ad = s->isAggregateDeclaration ())
+	{
+	  if (ad->members && ad->semanticRun >= PASSsemanticdone)
+	    d_collect_inline_candidates (ad->members, candidates);
+	}
+      else if (FuncDeclaration *fd = s->isFuncDeclaration ())
+	{
+	  if (d_cross_module_inline_p (fd))
+	    candidates->push (fd);
+	}
+    }
+}
+
+/* Run semantic3 on the small functions of all imported modules, so their
+   bodies are available to the optimizer for inlining.  The functions that
+   compiled without errors are put in CANDIDATES.  */
+
+static void
+d_semantic_cross_module_inline (FuncDeclarations *candidates)
+{
+  FuncDeclarations funcs;
+
+  for (size_t i = 0; i < Module::amodules.dim; i++)
+    {
+      Module *m = Module::amodules[i];
+      if (m->isRoot () || !m->members)
+	continue;
+
+      d_collect_inline_candidates (m->members, &funcs);
+    }
+
+  /* The modules that these functions belong to have already been compiled,
+     so any errors raised now are only a reason not to inline them.  */
+  for (size_t i = 0; i < funcs.dim; i++)
+    {
+      FuncDeclaration *fd = funcs[i];
+      unsigned errors = global.startGagging ();
+
+      if (fd->semanticRun < PASSsemantic3 && fd->_scope)
+	fd->semantic3 (fd->_scope);
+
+      Module::runDeferredSemantic3 ();
+
+      if (!global.endGagging (errors) && !fd->semantic3Errors
+	  && fd->semanticRun == PASSsemantic3done)
+	candidates->push (fd);
+    }
+}
+
+/* Write the -ftime-trace output next to the object file, unless given
+   a file name.  This is registered with atexit, so that the trace is
+   also written when the compiler stops early through fatal().  */
+
+static void
+d_write_time_trace()
+{
+  const char *filename = global.params.timeTraceFile;
+
+  if (!filename)
+    {
+      if (aux_base_name)
+	filename = concat (aux_base_name, ".time-trace.json", NULL);
+      else if (main_input_filename && main_input_filename[0])
+	filename = FileName::forceExt (FileName::name (main_input_filename),
+				       "time-trace.json");
+      else
+	return;
+    }
+
+  timeTraceWrite (filename);
+}
+
 void
 d_parse_file()
 {
@@ -1061,6 +1323,9 @@ d_parse_file()
       fprintf(global.stdmsg, "version   %s\n", global.version);
     }
 
+  if (global.params.timeTrace)
+    atexit (d_write_time_trace);
+
   // Start the main input file, if the debug writer wants it.
   if (debug_hooks->start_end_main_source_file)
     (*debug_hooks->start_source_file)(0, main_input_filename);
@@ -1075,6 +1340,9 @@ d_parse_file()
   Modules modules;
   modules.reserve(num_in_fnames);
 
+  // Functions from imported modules compiled for inlining.
+  FuncDeclarations inlines;
+
   if (!main_input_filename || !main_input_filename[0])
     {
       error("input file name required; cannot use stdin");
@@ -1141,17 +1409,31 @@ d_parse_file()
   for (size_t i = 0; i < modules.dim; i++)
     {
       Module *m = modules[i];
+      TimeTraceScope trace ("Read", m);
       m->read(Loc());
     }
 
-  // Parse files
-  for (size_t i = 0; i < modules.dim; i++)
+  // Parse files, first in parallel if requested, then finish the
+  // rest of Module::parse in order.
+  deferred_diagnostics **diagnostics = NULL;
+  if (d_option.parse_threads > 1 && modules.dim > 1)
+    {
+      TimeTraceScope trace ("Parse in parallel");
+      diagnostics = XCNEWVEC (deferred_diagnostics *, modules.dim);
+      d_parse_modules_parallel (&modules, diagnostics, d_option.parse_threads);
+    }
+
+  for (size_t i = 0, n = 0; i < modules.dim; i++, n++)
     {
       Module *m = modules[i];
+      TimeTraceScope trace ("Parse", m);
 
       if (global.params.verbose)
 	fprintf(global.stdmsg, "parse     %s\n", m->toChars());
 
+      if (diagnostics)
+	emit_deferred_diagnostics (diagnostics[n]);
+
       if (!Module::rootModule)
 	Module::rootModule = m;
 
@@ -1168,6 +1450,9 @@ d_parse_file()
 	}
     }
 
+  if (diagnostics)
+    XDELETEVEC (diagnostics);
+
   if (global.errors)
     goto had_errors;
 
@@ -1198,6 +1483,7 @@ d_parse_file()
   for (size_t i = 0; i < modules.dim; i++)
     {
       Module *m = modules[i];
+      TimeTraceScope trace ("Import all", m);
 
       if (global.params.verbose)
 	fprintf(global.stdmsg, "importall %s\n", m->toChars());
@@ -1212,6 +1498,7 @@ d_parse_file()
   for (size_t i = 0; i < modules.dim; i++)
     {
       Module *m = modules[i];
+      TimeTraceScope trace ("Semantic1", m);
 
       if (global.params.verbose)
 	fprintf(global.stdmsg, "semantic  %s\n", m->toChars());
@@ -1221,7 +1508,10 @@ d_parse_file()
 
   // Do deferred semantic analysis
   Module::dprogress = 1;
-  Module::runDeferredSemantic();
+  {
+    TimeTraceScope trace ("Deferred semantic");
+    Module::runDeferredSemantic();
+  }
 
   if (Module::deferred.dim)
     {
@@ -1243,6 +1533,7 @@ d_parse_file()
   for (size_t i = 0; i < modules.dim; i++)
     {
       Module *m = modules[i];
+      TimeTraceScope trace ("Semantic2", m);
 
       if (global.params.verbose)
 	fprintf(global.stdmsg, "semantic2 %s\n", m->toChars());
@@ -1250,7 +1541,10 @@ d_parse_file()
       m->semantic2(NULL);
     }
 
-  Module::runDeferredSemantic2();
+  {
+    TimeTraceScope trace ("Deferred semantic2");
+    Module::runDeferredSemantic2();
+  }
 
   if (global.errors)
     goto had_errors;
@@ -1259,6 +1553,7 @@ d_parse_file()
   for (size_t i = 0; i < modules.dim; i++)
     {
       Module *m = modules[i];
+      TimeTraceScope trace ("Semantic3", m);
 
       if (global.params.verbose)
 	fprintf(global.stdmsg, "semantic3 %s\n", m->toChars());
@@ -1266,7 +1561,10 @@ d_parse_file()
       m->semantic3(NULL);
     }
 
-  Module::runDeferredSemantic3();
+  {
+    TimeTraceScope trace ("Deferred semantic3");
+    Module::runDeferredSemantic3();
+  }
 
   // Check again, incase semantic3 pass loaded any more modules.
   while (builtin_modules.dim != 0)
@@ -1275,6 +1573,13 @@ d_parse_file()
       d_maybe_set_builtin(m);
     }
 
+  // Compile small functions from imported modules for inlining.
+  if (flag_cross_module_inline && optimize && !flag_syntax_only)
+    {
+      TimeTraceScope trace ("Cross-module inline");
+      d_semantic_cross_module_inline (&inlines);
+    }
+
   // Do not attempt to generate output files if errors or warnings occurred
   if (global.errors || global.warnings)
     goto had_errors;
@@ -1372,6 +1677,8 @@ d_parse_file()
       if (d_option.fonly && m != Module::rootModule)
 	continue;
 
+      TimeTraceScope trace ("Codegen", m);
+
       if (global.params.verbose)
 	fprintf(global.stdmsg, "code      %s\n", m->toChars());
 
@@ -1384,6 +1691,19 @@ d_parse_file()
 	}
     }
 
+  /* Emit the bodies of imported functions, these are only made available
+     to the optimizer and are never written out.  */
+  for (size_t i = 0; i < inlines.dim; i++)
+    build_decl_tree (inlines[i]);
+
+  if (global.params.verbose)
+    {
+      Module::printStats ();
+      TemplateDeclaration::printStats ();
+      CtfeStatus::printStats ();
+      Mem::printStats (global.stdmsg);
+    }
+
   // And end the main input file, if the debug writer wants it.
   if (debug_hooks->start_end_main_source_file)
     (*debug_hooks->end_source_file)(0);
@@ -584,6 +584,12 @@ public:
 	if (IDENTIFIER_DSYMBOL (ident) && IDENTIFIER_DSYMBOL (ident) != d)
 	  return;
 
+	/* Static variables of functions from imported modules compiled for
+	   inlining are defined by the module that they belong to.  */
+	if (!d->isInstantiated () && d->getModule ()
+	    && !d->getModule ()->isRoot ())
+	  return;
+
 	if (d->isThreadlocal ())
 	  {
 	    ModuleInfo *mi = current_module_info;
@@ -391,6 +391,12 @@ extern void d_build_builtins_module (Module *);
 extern void d_maybe_set_builtin (Module *);
 extern Expression *build_expression (tree);
 
+/* In d-glue.cc.  */
+struct deferred_diagnostics;
+extern deferred_diagnostics *start_deferred_diagnostics (void);
+extern void stop_deferred_diagnostics (void);
+extern void emit_deferred_diagnostics (deferred_diagnostics *);
+
 /* In d-convert.cc.  */
 extern tree d_truthvalue_conversion (tree);
 
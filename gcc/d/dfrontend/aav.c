@@ -1,4 +1,3 @@
-
 /* Copyright (c) 2010-2014 by Digital Mars
  * All Rights Reserved, written by Walter Bright
  * http://www.digitalmars.com
@@ -10,6 +9,13 @@
 /**
  * Implementation of associative arrays.
  *
+ * The table is open addressed using Robin Hood hashing with linear probing.
+ * Entries are stored inline in the slot array, so inserting a key never
+ * allocates unless the table has to grow, and deletion uses backward
+ * shifting so no tombstones are ever left behind.
+ *
+ * Pointers returned by dmd_aaGet() are only valid until the next insertion
+ * into the same table.
  */
 
 #include <stdio.h>
@@ -21,29 +27,46 @@
 #include "rmem.h"
 
 
+/* Keys are mostly pointers to heap objects, whose low bits are always zero,
+ * or already computed hash values.  Mix all bits of the key down into the
+ * low bits that are used to index the table.
+ */
 inline size_t hash(size_t a)
 {
-    a ^= (a >> 20) ^ (a >> 12);
-    return a ^ (a >> 7) ^ (a >> 4);
+    unsigned long long h = a;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (size_t)h;
 }
 
 struct aaA
 {
-    aaA *next;
     Key key;
     Value value;
+    size_t dist;        // distance from the home slot + 1, 0 if slot is empty
 };
 
 struct AA
 {
-    aaA* *b;
-    size_t b_length;
-    size_t nodes;       // total number of aaA nodes
-    aaA* binit[4];      // initial value of b[]
-
-    aaA aafirst;        // a lot of these AA's have only one entry
+    aaA *b;
+    size_t b_length;    // number of slots, always a power of 2
+    size_t nodes;       // total number of used slots
+    aaA binit[4];       // initial value of b[], a lot of these AA's are tiny
 };
 
+/****************************************************
+ * Returns true if adding one more entry to aa would exceed
+ * the maximum load factor of 7/8.
+ */
+
+static inline bool aaNeedsGrow(AA *aa)
+{
+    return (aa->nodes + 1) * 8 > aa->b_length * 7;
+}
+
 /****************************************************
  * Determine number of entries in associative array.
  */
@@ -66,48 +89,73 @@ Value* dmd_aaGet(AA** paa, Key key)
 
     if (!*paa)
     {   AA *a = (AA *)mem.xmalloc(sizeof(AA));
-        a->b = (aaA**)a->binit;
+        a->b = a->binit;
         a->b_length = 4;
         a->nodes = 0;
-        a->binit[0] = NULL;
-        a->binit[1] = NULL;
-        a->binit[2] = NULL;
-        a->binit[3] = NULL;
+        memset(a->binit, 0, sizeof(a->binit));
         *paa = a;
         assert((*paa)->b_length == 4);
     }
     //printf("paa = %p, *paa = %p\n", paa, *paa);
 
-    assert((*paa)->b_length);
-    size_t i = hash((size_t)key) & ((*paa)->b_length - 1);
-    aaA** pe = &(*paa)->b[i];
-    aaA *e;
-    while ((e = *pe) != NULL)
+    AA *aa = *paa;
+    assert(aa->b_length);
+    size_t mask = aa->b_length - 1;
+    size_t i = hash((size_t)key) & mask;
+    size_t dist = 1;
+
+    // Robin Hood invariant: the key cannot be any further along than
+    // the first entry that is closer to its own home slot than we are.
+    while (aa->b[i].dist >= dist)
     {
-        if (key == e->key)
-            return &e->value;
-        pe = &e->next;
+        if (key == aa->b[i].key)
+            return &aa->b[i].value;
+        i = (i + 1) & mask;
+        dist++;
     }
 
     // Not found, create new elem
     //printf("create new one\n");
 
-    size_t nodes = ++(*paa)->nodes;
-    e = (nodes != 1) ? (aaA *)mem.xmalloc(sizeof(aaA)) : &(*paa)->aafirst;
-    //e = new aaA();
-    e->next = NULL;
-    e->key = key;
-    e->value = NULL;
-    *pe = e;
-
-    //printf("length = %d, nodes = %d\n", (*paa)->b_length, nodes);
-    if (nodes > (*paa)->b_length * 2)
+    if (aaNeedsGrow(aa))
     {
         //printf("rehash\n");
         dmd_aaRehash(paa);
+        aa = *paa;
+        mask = aa->b_length - 1;
+        i = hash((size_t)key) & mask;
+        dist = 1;
+        while (aa->b[i].dist >= dist)
+        {
+            i = (i + 1) & mask;
+            dist++;
+        }
     }
 
-    return &e->value;
+    aa->nodes++;
+    aaA *slot = &aa->b[i];
+
+    // Take the slot from its current owner, and shift it and every
+    // entry after it along until an empty slot is found.
+    aaA e;
+    e.key = key;
+    e.value = NULL;
+    e.dist = dist;
+    while (aa->b[i].dist)
+    {
+        if (aa->b[i].dist < e.dist)
+        {
+            aaA tmp = aa->b[i];
+            aa->b[i] = e;
+            e = tmp;
+        }
+        i = (i + 1) & mask;
+        e.dist++;
+    }
+    aa->b[i] = e;
+
+    //printf("length = %d, nodes = %d\n", aa->b_length, aa->nodes);
+    return &slot->value;
 }
 
 
@@ -121,21 +169,55 @@ Value dmd_aaGetRvalue(AA* aa, Key key)
     //printf("_aaGetRvalue(key = %p)\n", key);
     if (aa)
     {
-        size_t i;
-        size_t len = aa->b_length;
-        i = hash((size_t)key) & (len-1);
-        aaA* e = aa->b[i];
-        while (e)
+        size_t mask = aa->b_length - 1;
+        size_t i = hash((size_t)key) & mask;
+        for (size_t dist = 1; aa->b[i].dist >= dist; dist++)
         {
-            if (key == e->key)
-                return e->value;
-            e = e->next;
+            if (key == aa->b[i].key)
+                return aa->b[i].value;
+            i = (i + 1) & mask;
         }
     }
     return NULL;    // not found
 }
 
 
+/*************************************************
+ * Remove entry indexed by key from associative array.
+ * Returns true if the key was found.
+ */
+
+bool dmd_aaDel(AA* aa, Key key)
+{
+    if (!aa)
+        return false;
+
+    size_t mask = aa->b_length - 1;
+    size_t i = hash((size_t)key) & mask;
+    for (size_t dist = 1; aa->b[i].dist >= dist; dist++)
+    {
+        if (key == aa->b[i].key)
+        {
+            // Shift all following entries that are not in their home
+            // slot back by one, instead of leaving a tombstone.
+            size_t j = (i + 1) & mask;
+            while (aa->b[j].dist > 1)
+            {
+                aa->b[i] = aa->b[j];
+                aa->b[i].dist--;
+                i = j;
+                j = (j + 1) & mask;
+            }
+            memset(&aa->b[i], 0, sizeof(aaA));
+            aa->nodes--;
+            return true;
+        }
+        i = (i + 1) & mask;
+    }
+    return false;
+}
+
+
 /********************************************
  * Rehash an array.
  */
@@ -152,21 +234,32 @@ void dmd_aaRehash(AA** paa)
             if (len == 4)
                 len = 32;
             else
-                len *= 4;
-            aaA** newb = (aaA**)mem.xmalloc(sizeof(aaA)*len);
-            memset(newb, 0, len * sizeof(aaA*));
+                len *= 2;
+            size_t mask = len - 1;
+            aaA *newb = (aaA *)mem.xcalloc(len, sizeof(aaA));
 
             for (size_t k = 0; k < aa->b_length; k++)
-            {   aaA *e = aa->b[k];
-                while (e)
-                {   aaA* enext = e->next;
-                    size_t j = hash((size_t)e->key) & (len-1);
-                    e->next = newb[j];
-                    newb[j] = e;
-                    e = enext;
+            {
+                if (!aa->b[k].dist)
+                    continue;
+
+                aaA e = aa->b[k];
+                size_t j = hash((size_t)e.key) & mask;
+                e.dist = 1;
+                while (newb[j].dist)
+                {
+                    if (newb[j].dist < e.dist)
+                    {
+                        aaA tmp = newb[j];
+                        newb[j] = e;
+                        e = tmp;
+                    }
+                    j = (j + 1) & mask;
+                    e.dist++;
                 }
+                newb[j] = e;
             }
-            if (aa->b != (aaA**)aa->binit)
+            if (aa->b != aa->binit)
                 mem.xfree(aa->b);
 
             aa->b = newb;
@@ -188,6 +281,111 @@ void unittest_aa()
     *pv = (void *)3;
     v = dmd_aaGetRvalue(aa, NULL);
     assert(v == (void *)3);
+
+    // Grow well past the inline slots, then delete every other key
+    // and check the remaining entries are still reachable.
+    for (size_t i = 1; i <= 1000; i++)
+        *dmd_aaGet(&aa, (void *)(i * 16)) = (void *)i;
+    assert(dmd_aaLen(aa) == 1001);
+    for (size_t i = 1; i <= 1000; i += 2)
+        assert(dmd_aaDel(aa, (void *)(i * 16)));
+    assert(!dmd_aaDel(aa, (void *)16));
+    assert(dmd_aaLen(aa) == 501);
+    for (size_t i = 1; i <= 1000; i++)
+    {
+        v = dmd_aaGetRvalue(aa, (void *)(i * 16));
+        assert(v == ((i & 1) ? NULL : (void *)i));
+    }
+    assert(dmd_aaGetRvalue(aa, NULL) == (void *)3);
+}
+
+#endif
+
+#if AAV_BENCHMARK
+
+/* Micro-benchmark of the associative array, build with:
+ *   g++ -O2 -DAAV_BENCHMARK aav.c rmem.c -o aavbench
+ *
+ * The key distributions model how the front end uses these tables:
+ *  - pointers to Identifiers allocated from the bump pointer heap,
+ *    looked up in many small DsymbolTables, mostly hitting;
+ *  - TemplateInstance::toHash() values in a few large tables,
+ *    with a mix of hits and misses.
+ */
+
+#include <time.h>
+
+static unsigned long long rng = 88172645463325252ULL;
+
+static size_t xorshift()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (size_t)rng;
+}
+
+static double elapsed(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main()
+{
+    const size_t nkeys = 1 << 16;
+    Key *keys = (Key *)mem.xmalloc(nkeys * sizeof(Key));
+
+    // Identifier-like keys, 16 byte aligned with a varying stride.
+    size_t p = 0x7f0000000000ULL & (size_t)-1;
+    for (size_t i = 0; i < nkeys; i++)
+    {
+        p += 32 + (xorshift() % 6) * 16;
+        keys[i] = (Key)p;
+    }
+
+    const size_t ntables = 4096;
+    AA **tables = (AA **)mem.xcalloc(ntables, sizeof(AA *));
+    clock_t start = clock();
+    for (size_t i = 0; i < nkeys; i++)
+        *dmd_aaGet(&tables[i % ntables], keys[i]) = keys[i];
+    double tinsert = elapsed(start);
+
+    size_t found = 0;
+    start = clock();
+    for (size_t n = 0; n < 64; n++)
+    {
+        for (size_t t = 0; t < ntables; t++)
+        {
+            for (size_t i = 0; i < nkeys / ntables; i++)
+                found += dmd_aaGetRvalue(tables[t], keys[i * ntables + t]) != NULL;
+        }
+    }
+    double tlookup = elapsed(start);
+    printf("symbol tables:   insert %.3fs  lookup %.3fs  (%u found)\n",
+           tinsert, tlookup, (unsigned)found);
+
+    // Hash keyed template instance tables.
+    for (size_t i = 0; i < nkeys; i++)
+        keys[i] = (Key)xorshift();
+
+    AA *instances = NULL;
+    start = clock();
+    for (size_t i = 0; i < nkeys; i += 2)
+        *dmd_aaGet(&instances, keys[i]) = keys[i];
+    tinsert = elapsed(start);
+
+    found = 0;
+    start = clock();
+    for (size_t n = 0; n < 64; n++)
+    {
+        for (size_t i = 0; i < nkeys; i++)
+            found += dmd_aaGetRvalue(instances, keys[i]) != NULL;
+    }
+    tlookup = elapsed(start);
+    printf("instance tables: insert %.3fs  lookup %.3fs  (%u found)\n",
+           tinsert, tlookup, (unsigned)found);
+
+    return 0;
 }
 
 #endif
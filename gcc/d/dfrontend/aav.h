@@ -15,5 +15,6 @@ struct AA;
 size_t dmd_aaLen(AA* aa);
 Value* dmd_aaGet(AA** aa, Key key);
 Value dmd_aaGetRvalue(AA* aa, Key key);
+bool dmd_aaDel(AA* aa, Key key);
 void dmd_aaRehash(AA** paa);
 
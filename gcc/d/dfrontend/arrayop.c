@@ -209,8 +209,7 @@ Expression *arrayOp(BinExp *e, Scope *sc)
     char *name = buf.peekString();
     Identifier *ident = Identifier::idPool(name);
 
-    FuncDeclaration **pFd = (FuncDeclaration **)dmd_aaGet(&arrayfuncs, (void *)ident);
-    FuncDeclaration *fd = *pFd;
+    FuncDeclaration *fd = (FuncDeclaration *)dmd_aaGetRvalue(arrayfuncs, (void *)ident);
 
     if (!fd)
         fd = buildArrayOp(ident, e, sc, e->loc);
@@ -229,7 +228,10 @@ Expression *arrayOp(BinExp *e, Scope *sc)
         return new ErrorExp();
     }
 
-    *pFd = fd;
+    /* Semantic of the generated function may have inserted into arrayfuncs,
+     * so look up the slot again rather than holding onto it.
+     */
+    *(FuncDeclaration **)dmd_aaGet(&arrayfuncs, (void *)ident) = fd;
 
     Expression *ev = new VarExp(e->loc, fd);
     Expression *ec = new CallExp(e->loc, ev, arguments);
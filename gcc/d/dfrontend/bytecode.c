@@ -0,0 +1,1139 @@
+
+/* Compiler implementation of the D programming language
+ * Copyright (c) 1999-2016 by Digital Mars
+ * All Rights Reserved
+ * http://www.digitalmars.com
+ * Distributed under the Boost Software License, Version 1.0.
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+
+/* Bytecode engine for CTFE.
+ *
+ * Functions that only operate on integral scalars (bool, character and
+ * integer types) are lowered to a register based bytecode with one typed
+ * slot per parameter, local variable, constant and temporary.  The bytecode
+ * is cached per FuncDeclaration, and run instead of walking the AST with
+ * the Interpreter.
+ *
+ * Anything else is not supported, and makes bcInterpret() return NULL so
+ * the caller falls back to the Interpreter.  The same happens at run time
+ * on anything that would be an error, such as division by zero or a failed
+ * assert: as supported functions cannot have side effects outside of their
+ * own frame, the Interpreter can simply run the call again from the start
+ * and produce the proper diagnostic.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "rmem.h"
+#include "aav.h"
+
+#include "mars.h"
+#include "mtype.h"
+#include "expression.h"
+#include "statement.h"
+#include "declaration.h"
+#include "init.h"
+#include "id.h"
+#include "ctfe.h"
+#include "visitor.h"
+
+enum BCKind
+{
+    BCnone,
+    BCbool,
+    BCi8,  BCu8,
+    BCi16, BCu16,
+    BCi32, BCu32,
+    BCi64, BCu64,
+};
+
+enum BCOp
+{
+    BCmov,      // dst = a
+    BCcast,     // dst = cast(kind) a
+    BCtobool,   // dst = a != 0
+    BCneg,      // dst = -a
+    BCcom,      // dst = ~a
+    BCnot,      // dst = !a
+    BCadd, BCsub, BCmul, BCdiv, BCmod,
+    BCand, BCor, BCxor,
+    BCshl, BCshr, BCushr,
+    BCeq, BCne, BClt, BCle, BCgt, BCge,
+    BCjmp,      // goto dst
+    BCjz,       // if (!a) goto dst
+    BCjnz,      // if (a) goto dst
+    BCcall,     // dst = callees[a](slots b ..), in a new frame
+    BCret,      // return a
+    BCretvoid,  // return
+    BChalt,     // bail out
+};
+
+struct BCIns
+{
+    unsigned char op;
+    unsigned char kind;         // type of the result, or of the operands for compares
+    unsigned dst;
+    unsigned a;
+    unsigned b;
+};
+
+struct BCFunction
+{
+    FuncDeclaration *fd;
+    bool ok;                    // false if the function could not be compiled
+    BCIns *code;
+    unsigned ncode;
+    unsigned nparams;           // parameters are in slots [0 .. nparams]
+    unsigned nslots;
+    dinteger_t *init;           // initial value of all slots
+    FuncDeclaration **callees;  // functions called by BCcall
+    BCFunction **bccallees;     // and their bytecode, once resolved
+    unsigned ncallees;
+    unsigned char retkind;      // BCnone for void functions
+    bool warned;                // -Wctfe-fallback was given for it
+};
+
+// Cache of compiled functions, keyed by FuncDeclaration.
+static AA *bcfunctions;
+
+// Value stack shared by all frames.
+static dinteger_t *bcstack;
+static size_t bcstacksize;
+static int bcdepth;
+
+static void bcReserve(size_t nslots)
+{
+    if (!bcstack || nslots > bcstacksize)
+    {
+        bcstacksize = nslots < 256 ? 256 : nslots * 2;
+        bcstack = (dinteger_t *)mem.xrealloc(bcstack, bcstacksize * sizeof(dinteger_t));
+    }
+}
+
+/* Copy the contents of a, which is about to go out of scope.
+ */
+template <typename T>
+static T *copyArray(Array<T> &a)
+{
+    T *p = (T *)mem.xmalloc(a.dim * sizeof(T) + 1);
+    memcpy(p, a.tdata(), a.dim * sizeof(T));
+    return p;
+}
+
+/* Get the BCKind of a type, or BCnone if it's not supported.
+ */
+static unsigned char bcKind(Type *t)
+{
+    switch (t->toBasetype()->ty)
+    {
+        case Tbool:                 return BCbool;
+        case Tint8:                 return BCi8;
+        case Tuns8:  case Tchar:    return BCu8;
+        case Tint16:                return BCi16;
+        case Tuns16: case Twchar:   return BCu16;
+        case Tint32:                return BCi32;
+        case Tuns32: case Tdchar:   return BCu32;
+        case Tint64:                return BCi64;
+        case Tuns64:                return BCu64;
+        default:                    return BCnone;
+    }
+}
+
+static bool isSigned(unsigned char kind)
+{
+    return kind == BCi8 || kind == BCi16 || kind == BCi32 || kind == BCi64;
+}
+
+static unsigned bitSize(unsigned char kind)
+{
+    switch (kind)
+    {
+        case BCbool:                return 1;
+        case BCi8:  case BCu8:      return 8;
+        case BCi16: case BCu16:     return 16;
+        case BCi32: case BCu32:     return 32;
+        default:                    return 64;
+    }
+}
+
+/* Values are kept sign or zero extended to 64 bits according to their kind.
+ */
+static inline dinteger_t normalize(dinteger_t v, unsigned char kind)
+{
+    switch (kind)
+    {
+        case BCbool:    return v != 0;
+        case BCi8:      return (dinteger_t)(sinteger_t)(d_int8)v;
+        case BCu8:      return (d_uns8)v;
+        case BCi16:     return (dinteger_t)(sinteger_t)(d_int16)v;
+        case BCu16:     return (d_uns16)v;
+        case BCi32:     return (dinteger_t)(sinteger_t)(d_int32)v;
+        case BCu32:     return (d_uns32)v;
+        default:        return v;
+    }
+}
+
+/*********************************************
+ * Lowers a function body into bytecode.
+ */
+
+class BCCompiler : public Visitor
+{
+public:
+    BCFunction *bcf;
+    bool failed;
+    unsigned result;            // slot holding the result of an expression
+
+    Array<BCIns> code;
+    Array<dinteger_t> init;
+    Array<FuncDeclaration *> callees;
+    AA *vars;                   // VarDeclaration -> slot + 1
+
+    // Jumps to patch at the end of the innermost loop.
+    Array<unsigned> *breaks;
+    Array<unsigned> *continues;
+
+    BCCompiler(BCFunction *bcf)
+        : bcf(bcf)
+    {
+        failed = false;
+        result = 0;
+        vars = NULL;
+        breaks = NULL;
+        continues = NULL;
+    }
+
+    unsigned newSlot(dinteger_t value = 0)
+    {
+        init.push(value);
+        return (unsigned)(init.dim - 1);
+    }
+
+    unsigned emit(unsigned char op, unsigned char kind, unsigned dst, unsigned a = 0, unsigned b = 0)
+    {
+        BCIns ins;
+        ins.op = op;
+        ins.kind = kind;
+        ins.dst = dst;
+        ins.a = a;
+        ins.b = b;
+        code.push(ins);
+        return (unsigned)(code.dim - 1);
+    }
+
+    unsigned here()
+    {
+        return (unsigned)code.dim;
+    }
+
+    void patch(unsigned ins, unsigned target)
+    {
+        code[ins].dst = target;
+    }
+
+    bool declareVar(VarDeclaration *v)
+    {
+        unsigned char kind = bcKind(v->type);
+        if (kind == BCnone || (v->storage_class & (STCref | STCout | STClazy)))
+            return false;
+        if (v->isDataseg() || v->nestedrefs.dim)
+            return false;
+        *(size_t *)dmd_aaGet(&vars, (void *)v) = newSlot() + 1;
+        return true;
+    }
+
+    bool lookupVar(Declaration *d, unsigned *slot)
+    {
+        size_t n = (size_t)dmd_aaGetRvalue(vars, (void *)d);
+        if (!n)
+            return false;
+        *slot = (unsigned)(n - 1);
+        return true;
+    }
+
+    /* Compile e, and return the slot holding its value.
+     */
+    unsigned compile(Expression *e)
+    {
+        if (failed)
+            return 0;
+        result = 0;
+        e->accept(this);
+        return result;
+    }
+
+    void compile(Statement *s)
+    {
+        if (!failed && s)
+            s->accept(this);
+    }
+
+    /* Compile a condition, branching to the returned instruction when
+     * it is false, or when it is true if jumpIfTrue is set.
+     */
+    unsigned compileCondition(Expression *e, bool jumpIfTrue)
+    {
+        unsigned char kind = bcKind(e->type);
+        unsigned cond = compile(e);
+        if (kind == BCnone)
+            failed = true;
+        if (kind != BCbool)
+        {
+            unsigned tmp = newSlot();
+            emit(BCtobool, BCbool, tmp, cond);
+            cond = tmp;
+        }
+        return emit(jumpIfTrue ? BCjnz : BCjz, BCbool, 0, cond);
+    }
+
+    /* Compile body of function.
+     */
+    void compileFunction(FuncDeclaration *fd)
+    {
+        TypeFunction *tf = (TypeFunction *)fd->type->toBasetype();
+        if (tf->varargs || tf->isref || fd->vthis || fd->vresult || fd->isNested())
+        {
+            failed = true;
+            return;
+        }
+
+        if (tf->next->toBasetype()->ty == Tvoid)
+            bcf->retkind = BCnone;
+        else if ((bcf->retkind = bcKind(tf->next)) == BCnone)
+        {
+            failed = true;
+            return;
+        }
+
+        size_t dim = fd->parameters ? fd->parameters->dim : 0;
+        for (size_t i = 0; i < dim; i++)
+        {
+            if (!declareVar((*fd->parameters)[i]))
+            {
+                failed = true;
+                return;
+            }
+        }
+        bcf->nparams = (unsigned)dim;
+
+        compile(fd->fbody);
+        emit(bcf->retkind == BCnone ? BCretvoid : BChalt, BCnone, 0);
+    }
+
+    /********** Statements **********/
+
+    void visit(Statement *)
+    {
+        failed = true;
+    }
+
+    void visit(ExpStatement *s)
+    {
+        if (s->exp)
+            compile(s->exp);
+    }
+
+    void visit(CompoundStatement *s)
+    {
+        for (size_t i = 0; i < s->statements->dim; i++)
+            compile((*s->statements)[i]);
+    }
+
+    void visit(CompoundAsmStatement *)
+    {
+        failed = true;
+    }
+
+    void visit(ScopeStatement *s)
+    {
+        compile(s->statement);
+    }
+
+    void visit(IfStatement *s)
+    {
+        if (s->match)
+        {
+            failed = true;
+            return;
+        }
+        unsigned jelse = compileCondition(s->condition, false);
+        compile(s->ifbody);
+        if (s->elsebody)
+        {
+            unsigned jend = emit(BCjmp, BCnone, 0);
+            patch(jelse, here());
+            compile(s->elsebody);
+            patch(jend, here());
+        }
+        else
+            patch(jelse, here());
+    }
+
+    void compileLoop(Statement *body, unsigned *continueTarget, Array<unsigned> *brk, Array<unsigned> *cont)
+    {
+        Array<unsigned> *oldbreaks = breaks;
+        Array<unsigned> *oldcontinues = continues;
+        breaks = brk;
+        continues = cont;
+        compile(body);
+        breaks = oldbreaks;
+        continues = oldcontinues;
+        *continueTarget = here();
+    }
+
+    void visit(ForStatement *s)
+    {
+        Array<unsigned> brk;
+        Array<unsigned> cont;
+        unsigned target;
+
+        compile(s->_init);
+        unsigned top = here();
+        unsigned jexit = 0;
+        if (s->condition)
+            jexit = compileCondition(s->condition, false);
+        compileLoop(s->_body, &target, &brk, &cont);
+        if (s->increment)
+            compile(s->increment);
+        emit(BCjmp, BCnone, top);
+
+        if (s->condition)
+            patch(jexit, here());
+        for (size_t i = 0; i < brk.dim; i++)
+            patch(brk[i], here());
+        for (size_t i = 0; i < cont.dim; i++)
+            patch(cont[i], target);
+    }
+
+    void visit(DoStatement *s)
+    {
+        Array<unsigned> brk;
+        Array<unsigned> cont;
+        unsigned target;
+
+        unsigned top = here();
+        compileLoop(s->_body, &target, &brk, &cont);
+        unsigned jtop = compileCondition(s->condition, true);
+        patch(jtop, top);
+
+        for (size_t i = 0; i < brk.dim; i++)
+            patch(brk[i], here());
+        for (size_t i = 0; i < cont.dim; i++)
+            patch(cont[i], target);
+    }
+
+    void visit(BreakStatement *s)
+    {
+        if (s->ident || !breaks)
+        {
+            failed = true;
+            return;
+        }
+        breaks->push(emit(BCjmp, BCnone, 0));
+    }
+
+    void visit(ContinueStatement *s)
+    {
+        if (s->ident || !continues)
+        {
+            failed = true;
+            return;
+        }
+        continues->push(emit(BCjmp, BCnone, 0));
+    }
+
+    void visit(ReturnStatement *s)
+    {
+        if (!s->exp)
+        {
+            emit(BCretvoid, BCnone, 0);
+            return;
+        }
+        if (bcf->retkind == BCnone || bcKind(s->exp->type) != bcf->retkind)
+        {
+            failed = true;
+            return;
+        }
+        unsigned r = compile(s->exp);
+        emit(BCret, bcf->retkind, 0, r);
+    }
+
+    /********** Expressions **********/
+
+    void visit(Expression *)
+    {
+        failed = true;
+    }
+
+    void visit(IntegerExp *e)
+    {
+        unsigned char kind = bcKind(e->type);
+        if (kind == BCnone)
+        {
+            failed = true;
+            return;
+        }
+        result = newSlot(normalize(e->getInteger(), kind));
+    }
+
+    void visit(VarExp *e)
+    {
+        VarDeclaration *v = e->var->isVarDeclaration();
+        if (v && v->ident == Id::ctfe)
+        {
+            result = newSlot(1);
+            return;
+        }
+        if (!lookupVar(e->var, &result))
+            failed = true;
+    }
+
+    void visit(DeclarationExp *e)
+    {
+        VarDeclaration *v = e->declaration->isVarDeclaration();
+        if (!v || v->toAlias() != v)
+        {
+            failed = true;
+            return;
+        }
+        // Manifest constants have already been folded.
+        if (v->storage_class & STCmanifest)
+            return;
+        if (!v->_init || !v->_init->isExpInitializer() || !declareVar(v))
+        {
+            failed = true;
+            return;
+        }
+        result = compile(v->_init->isExpInitializer()->exp);
+    }
+
+    void visit(CastExp *e)
+    {
+        unsigned char kind = bcKind(e->type);
+        unsigned char fromkind = bcKind(e->e1->type);
+        if (kind == BCnone || fromkind == BCnone)
+        {
+            failed = true;
+            return;
+        }
+        unsigned a = compile(e->e1);
+        result = newSlot();
+        emit(kind == BCbool ? BCtobool : BCcast, kind, result, a);
+    }
+
+    void visit(NegExp *e)
+    {
+        compileUnary(e, BCneg);
+    }
+
+    void visit(ComExp *e)
+    {
+        compileUnary(e, BCcom);
+    }
+
+    void visit(NotExp *e)
+    {
+        if (bcKind(e->e1->type) == BCnone)
+        {
+            failed = true;
+            return;
+        }
+        unsigned a = compile(e->e1);
+        result = newSlot();
+        emit(BCnot, BCbool, result, a);
+    }
+
+    void compileUnary(UnaExp *e, unsigned char op)
+    {
+        unsigned char kind = bcKind(e->type);
+        if (kind == BCnone || kind == BCbool || bcKind(e->e1->type) != kind)
+        {
+            failed = true;
+            return;
+        }
+        unsigned a = compile(e->e1);
+        result = newSlot();
+        emit(op, kind, result, a);
+    }
+
+    static unsigned char binOp(TOK op)
+    {
+        switch (op)
+        {
+            case TOKadd:    case TOKaddass:     return BCadd;
+            case TOKmin:    case TOKminass:     return BCsub;
+            case TOKmul:    case TOKmulass:     return BCmul;
+            case TOKdiv:    case TOKdivass:     return BCdiv;
+            case TOKmod:    case TOKmodass:     return BCmod;
+            case TOKand:    case TOKandass:     return BCand;
+            case TOKor:     case TOKorass:      return BCor;
+            case TOKxor:    case TOKxorass:     return BCxor;
+            case TOKshl:    case TOKshlass:     return BCshl;
+            case TOKshr:    case TOKshrass:     return BCshr;
+            case TOKushr:   case TOKushrass:    return BCushr;
+            case TOKequal:  case TOKidentity:   return BCeq;
+            case TOKnotequal: case TOKnotidentity: return BCne;
+            case TOKlt:                         return BClt;
+            case TOKle:                         return BCle;
+            case TOKgt:                         return BCgt;
+            case TOKge:                         return BCge;
+            default:                            return BCmov;
+        }
+    }
+
+    /* Compile both operands of e, evaluating e1 first.
+     */
+    void compileOperands(BinExp *e, unsigned *a, unsigned *b)
+    {
+        *a = compile(e->e1);
+        // Don't let side effects of e2 change what e1 evaluated to.
+        if (hasSideEffect(e->e2))
+        {
+            unsigned tmp = newSlot();
+            emit(BCmov, bcKind(e->e1->type), tmp, *a);
+            *a = tmp;
+        }
+        *b = compile(e->e2);
+    }
+
+    void visit(BinExp *e)
+    {
+        unsigned char op = binOp(e->op);
+        unsigned char kind = bcKind(e->type);
+        unsigned char kind1 = bcKind(e->e1->type);
+        unsigned char kind2 = bcKind(e->e2->type);
+        if (op == BCmov || kind == BCnone || kind1 == BCnone || kind2 == BCnone)
+        {
+            failed = true;
+            return;
+        }
+
+        if (op >= BCeq)
+        {
+            // Compare in the type of the operands.
+            if (kind1 != kind2)
+            {
+                failed = true;
+                return;
+            }
+            kind = kind1;
+        }
+        else if (kind1 != kind || (kind2 != kind && op != BCshl && op != BCshr && op != BCushr))
+        {
+            failed = true;
+            return;
+        }
+
+        unsigned a, b;
+        compileOperands(e, &a, &b);
+        result = newSlot();
+        emit(op, kind, result, a, b);
+    }
+
+    void visit(BinAssignExp *e)
+    {
+        unsigned char op = binOp(e->op);
+        unsigned char kind = bcKind(e->e1->type);
+        unsigned char kind2 = bcKind(e->e2->type);
+        unsigned v;
+        if (op == BCmov || kind == BCnone || kind == BCbool || kind2 == BCnone ||
+            e->e1->op != TOKvar || !lookupVar(((VarExp *)e->e1)->var, &v))
+        {
+            failed = true;
+            return;
+        }
+        // The truncated result of these doesn't depend on the width
+        // the operation is done in.
+        bool modular = (op == BCadd || op == BCsub || op == BCmul ||
+                        op == BCand || op == BCor || op == BCxor || op == BCshl);
+        // Narrow operands are promoted to int before an unsigned shift.
+        if ((kind2 != kind && !modular && op != BCshr && op != BCushr) ||
+            (op == BCushr && bitSize(kind) < 32))
+        {
+            failed = true;
+            return;
+        }
+
+        unsigned a, b;
+        compileOperands(e, &a, &b);
+        emit(op, kind, v, a, b);
+        result = v;
+    }
+
+    void visit(AssignExp *e)
+    {
+        unsigned char kind = bcKind(e->e1->type);
+        unsigned v;
+        if (kind == BCnone || bcKind(e->e2->type) != kind ||
+            e->e1->op != TOKvar || !lookupVar(((VarExp *)e->e1)->var, &v))
+        {
+            failed = true;
+            return;
+        }
+        unsigned b = compile(e->e2);
+        emit(BCmov, kind, v, b);
+        result = v;
+    }
+
+    void visit(PostExp *e)
+    {
+        unsigned char kind = bcKind(e->e1->type);
+        unsigned v;
+        if (kind == BCnone || kind == BCbool ||
+            e->e1->op != TOKvar || !lookupVar(((VarExp *)e->e1)->var, &v))
+        {
+            failed = true;
+            return;
+        }
+        result = newSlot();
+        emit(BCmov, kind, result, v);
+        emit(e->op == TOKplusplus ? BCadd : BCsub, kind, v, v, newSlot(1));
+    }
+
+    void visit(AndAndExp *e)
+    {
+        compileLogical(e, false);
+    }
+
+    void visit(OrOrExp *e)
+    {
+        compileLogical(e, true);
+    }
+
+    void compileLogical(BinExp *e, bool isOrOr)
+    {
+        if (e->type->toBasetype()->ty != Tbool)
+        {
+            failed = true;
+            return;
+        }
+        unsigned r = newSlot();
+        unsigned j1 = compileCondition(e->e1, isOrOr);
+        unsigned j2 = compileCondition(e->e2, isOrOr);
+        emit(BCmov, BCbool, r, newSlot(!isOrOr));
+        unsigned jend = emit(BCjmp, BCnone, 0);
+        patch(j1, here());
+        patch(j2, here());
+        emit(BCmov, BCbool, r, newSlot(isOrOr));
+        patch(jend, here());
+        result = r;
+    }
+
+    void visit(CondExp *e)
+    {
+        unsigned char kind = bcKind(e->type);
+        if (kind == BCnone || bcKind(e->e1->type) != kind || bcKind(e->e2->type) != kind)
+        {
+            failed = true;
+            return;
+        }
+        unsigned r = newSlot();
+        unsigned jelse = compileCondition(e->econd, false);
+        emit(BCmov, kind, r, compile(e->e1));
+        unsigned jend = emit(BCjmp, BCnone, 0);
+        patch(jelse, here());
+        emit(BCmov, kind, r, compile(e->e2));
+        patch(jend, here());
+        result = r;
+    }
+
+    void visit(CommaExp *e)
+    {
+        compile(e->e1);
+        result = compile(e->e2);
+    }
+
+    void visit(AssertExp *e)
+    {
+        unsigned j = compileCondition(e->e1, true);
+        emit(BChalt, BCnone, 0);
+        patch(j, here());
+        result = newSlot();
+    }
+
+    void visit(HaltExp *)
+    {
+        emit(BChalt, BCnone, 0);
+        result = newSlot();
+    }
+
+    void visit(CallExp *e)
+    {
+        FuncDeclaration *f = e->f;
+        if (!f || e->e1->op != TOKvar || ((VarExp *)e->e1)->var != f ||
+            f->needThis() || f->isNested() || isBuiltin(f) != BUILTINno)
+        {
+            failed = true;
+            return;
+        }
+
+        TypeFunction *tf = (TypeFunction *)f->type->toBasetype();
+        unsigned char retkind = BCnone;
+        if (tf->next->toBasetype()->ty != Tvoid && (retkind = bcKind(tf->next)) == BCnone)
+        {
+            failed = true;
+            return;
+        }
+
+        // Evaluate arguments, then copy them into consecutive slots.
+        size_t dim = e->arguments ? e->arguments->dim : 0;
+        Array<unsigned> args;
+        args.setDim(dim);
+        for (size_t i = 0; i < dim; i++)
+        {
+            Expression *arg = (*e->arguments)[i];
+            Parameter *p = Parameter::getNth(tf->parameters, i);
+            if (!p || (p->storageClass & (STCref | STCout | STClazy)) ||
+                bcKind(arg->type) == BCnone || bcKind(arg->type) != bcKind(p->type))
+            {
+                failed = true;
+                return;
+            }
+            args[i] = compile(arg);
+            if (i + 1 < dim && hasSideEffect((*e->arguments)[i + 1]))
+            {
+                unsigned tmp = newSlot();
+                emit(BCmov, bcKind(arg->type), tmp, args[i]);
+                args[i] = tmp;
+            }
+        }
+        unsigned first = (unsigned)init.dim;
+        for (size_t i = 0; i < dim; i++)
+            emit(BCmov, bcKind((*e->arguments)[i]->type), newSlot(), args[i]);
+
+        unsigned index = 0;
+        while (index < callees.dim && callees[index] != f)
+            index++;
+        if (index == callees.dim)
+            callees.push(f);
+
+        result = newSlot();
+        emit(BCcall, retkind, result, index, first);
+    }
+};
+
+/*********************************************
+ * Get the bytecode for fd, compiling it if it hasn't been seen before.
+ * Returns NULL if fd can't be run on the bytecode engine.
+ */
+
+static BCFunction *bcCompile(FuncDeclaration *fd)
+{
+    BCFunction *bcf = (BCFunction *)dmd_aaGetRvalue(bcfunctions, (void *)fd);
+    if (bcf)
+        return bcf->ok ? bcf : NULL;
+
+    // Not cached as failed, as the function may be ready later on.
+    if (fd->semanticRun < PASSsemantic3done)
+        return NULL;
+
+    bcf = new BCFunction();
+    memset(bcf, 0, sizeof(BCFunction));
+    bcf->fd = fd;
+    *(BCFunction **)dmd_aaGet(&bcfunctions, (void *)fd) = bcf;
+
+    if (!fd->fbody || fd->semantic3Errors)
+        return NULL;
+
+    BCCompiler bcc(bcf);
+    bcc.compileFunction(fd);
+    if (bcc.failed)
+        return NULL;
+
+    bcf->ok = true;
+    bcf->code = copyArray(bcc.code);
+    bcf->ncode = (unsigned)bcc.code.dim;
+    bcf->nslots = (unsigned)bcc.init.dim;
+    bcf->init = copyArray(bcc.init);
+    bcf->ncallees = (unsigned)bcc.callees.dim;
+    bcf->callees = copyArray(bcc.callees);
+    bcf->bccallees = (BCFunction **)mem.xcalloc(bcf->ncallees + 1, sizeof(BCFunction *));
+    return bcf;
+}
+
+static bool bcExecute(BCFunction *bcf, size_t base, dinteger_t *pret);
+static void bcWarnFallback(FuncDeclaration *fd);
+
+/*********************************************
+ * Run bcf with its arguments already in the slots at base.
+ * Returns false if execution has to be abandoned.
+ */
+
+static bool bcRun(BCFunction *bcf, size_t base, dinteger_t *pret)
+{
+    bool ok = false;
+    if (++bcdepth <= CTFE_RECURSION_LIMIT)
+        ok = bcExecute(bcf, base, pret);
+    bcdepth--;
+    return ok;
+}
+
+static bool bcExecute(BCFunction *bcf, size_t base, dinteger_t *pret)
+{
+    // The arguments are already in place, initialize the rest of the frame.
+    bcReserve(base + bcf->nslots);
+    memcpy(bcstack + base + bcf->nparams, bcf->init + bcf->nparams,
+           (bcf->nslots - bcf->nparams) * sizeof(dinteger_t));
+
+    for (unsigned ip = 0; ; )
+    {
+        const BCIns *pc = &bcf->code[ip++];
+        // The stack may move during calls, so index it afresh each time.
+        dinteger_t *s = bcstack + base;
+
+        /* Only read the slots an instruction uses: a function may have no
+         * slots at all, and the a operand of BCcall is a callee index.
+         */
+        dinteger_t a = 0;
+        dinteger_t b = 0;
+        if (pc->op <= BCge || pc->op == BCjz || pc->op == BCjnz || pc->op == BCret)
+            a = s[pc->a];
+        if (pc->op >= BCadd && pc->op <= BCge)
+            b = s[pc->b];
+        unsigned char kind = pc->kind;
+
+        switch (pc->op)
+        {
+            case BCmov:
+                s[pc->dst] = a;
+                break;
+
+            case BCcast:
+                s[pc->dst] = normalize(a, kind);
+                break;
+
+            case BCtobool:
+                s[pc->dst] = a != 0;
+                break;
+
+            case BCneg:
+                s[pc->dst] = normalize(-a, kind);
+                break;
+
+            case BCcom:
+                s[pc->dst] = normalize(~a, kind);
+                break;
+
+            case BCnot:
+                s[pc->dst] = a == 0;
+                break;
+
+            case BCadd:
+                s[pc->dst] = normalize(a + b, kind);
+                break;
+
+            case BCsub:
+                s[pc->dst] = normalize(a - b, kind);
+                break;
+
+            case BCmul:
+                s[pc->dst] = normalize(a * b, kind);
+                break;
+
+            case BCdiv:
+            case BCmod:
+                if (b == 0)
+                    return false;
+                if (isSigned(kind))
+                {
+                    sinteger_t x = (sinteger_t)a;
+                    sinteger_t y = (sinteger_t)b;
+                    dinteger_t r;
+                    if (y == -1)
+                        r = pc->op == BCdiv ? -a : 0;
+                    else
+                        r = (dinteger_t)(pc->op == BCdiv ? x / y : x % y);
+                    s[pc->dst] = normalize(r, kind);
+                }
+                else
+                    s[pc->dst] = normalize(pc->op == BCdiv ? a / b : a % b, kind);
+                break;
+
+            case BCand:
+                s[pc->dst] = normalize(a & b, kind);
+                break;
+
+            case BCor:
+                s[pc->dst] = normalize(a | b, kind);
+                break;
+
+            case BCxor:
+                s[pc->dst] = normalize(a ^ b, kind);
+                break;
+
+            case BCshl:
+            case BCshr:
+            case BCushr:
+                if (b >= bitSize(kind))
+                    return false;   // shift out of range is an error in CTFE
+                if (pc->op == BCshl)
+                    s[pc->dst] = normalize(a << b, kind);
+                else if (pc->op == BCshr && isSigned(kind))
+                    s[pc->dst] = (dinteger_t)((sinteger_t)a >> b);
+                else
+                {
+                    // Logical shift of the value as an unsigned of the same size.
+                    unsigned bits = bitSize(kind);
+                    dinteger_t u = bits < 64 ? a & ((1ULL << bits) - 1) : a;
+                    s[pc->dst] = normalize(u >> b, kind);
+                }
+                break;
+
+            case BCeq:
+                s[pc->dst] = a == b;
+                break;
+
+            case BCne:
+                s[pc->dst] = a != b;
+                break;
+
+            case BClt:
+                s[pc->dst] = isSigned(kind) ? (sinteger_t)a < (sinteger_t)b : a < b;
+                break;
+
+            case BCle:
+                s[pc->dst] = isSigned(kind) ? (sinteger_t)a <= (sinteger_t)b : a <= b;
+                break;
+
+            case BCgt:
+                s[pc->dst] = isSigned(kind) ? (sinteger_t)a > (sinteger_t)b : a > b;
+                break;
+
+            case BCge:
+                s[pc->dst] = isSigned(kind) ? (sinteger_t)a >= (sinteger_t)b : a >= b;
+                break;
+
+            case BCjmp:
+                ip = pc->dst;
+                break;
+
+            case BCjz:
+                if (!a)
+                    ip = pc->dst;
+                break;
+
+            case BCjnz:
+                if (a)
+                    ip = pc->dst;
+                break;
+
+            case BCcall:
+            {
+                BCFunction *callee = bcf->bccallees[pc->a];
+                if (!callee)
+                {
+                    // Functions not yet semantically analysed are left to
+                    // the Interpreter, which will then run semantic3.
+                    FuncDeclaration *fd = bcf->callees[pc->a];
+                    callee = bcCompile(fd);
+                    if (!callee)
+                    {
+                        /* A callee that can't be compiled makes this
+                         * function unsupported too, so it isn't run as
+                         * far as the call again.
+                         */
+                        if (fd->semanticRun >= PASSsemantic3done)
+                            bcf->ok = false;
+                        bcWarnFallback(fd);
+                        return false;
+                    }
+                    bcf->bccallees[pc->a] = callee;
+                }
+                else if (!callee->ok)
+                {
+                    bcf->ok = false;
+                    return false;
+                }
+                // Pass the arguments in a new frame past the end of this one.
+                size_t newbase = base + bcf->nslots;
+                bcReserve(newbase + callee->nslots);
+                memcpy(bcstack + newbase, bcstack + base + pc->b,
+                       callee->nparams * sizeof(dinteger_t));
+                dinteger_t r = 0;
+                if (!bcRun(callee, newbase, &r))
+                    return false;
+                bcstack[base + pc->dst] = r;
+                break;
+            }
+
+            case BCret:
+                *pret = a;
+                return true;
+
+            case BCretvoid:
+                return true;
+
+            case BChalt:
+                return false;
+
+            default:
+                assert(0);
+        }
+    }
+}
+
+/*************************************
+ * Attempt to run fd on the bytecode engine, given the already
+ * interpreted arguments.
+ *
+ * Return result expression if successful, or NULL if the Interpreter
+ * must be used instead.
+ */
+
+/*************************************
+ * With -Wctfe-fallback, warn once that fd is not supported.
+ */
+
+static void bcWarnFallback(FuncDeclaration *fd)
+{
+    if (!global.params.warnCtfeFallback || global.diagnosticsGagged())
+        return;
+
+    BCFunction *bcf = (BCFunction *)dmd_aaGetRvalue(bcfunctions, (void *)fd);
+    if (!bcf || bcf->ok || bcf->warned)
+        return;
+
+    bcf->warned = true;
+    warning(fd->loc, "%s is evaluated by the AST interpreter, as the bytecode engine does not support it",
+        fd->toPrettyChars());
+}
+
+Expression *bcInterpret(FuncDeclaration *fd, Expressions *arguments, bool *failed)
+{
+    *failed = false;
+    BCFunction *bcf = bcCompile(fd);
+    if (!bcf)
+    {
+        bcWarnFallback(fd);
+        return NULL;
+    }
+
+    size_t dim = arguments ? arguments->dim : 0;
+    if (dim != bcf->nparams)
+        return NULL;
+
+    bcReserve(bcf->nslots);
+    for (size_t i = 0; i < dim; i++)
+    {
+        Expression *earg = (*arguments)[i];
+        if (earg->op != TOKint64)
+            return NULL;
+        bcstack[i] = normalize(earg->toInteger(), bcKind(earg->type));
+    }
+
+    dinteger_t r = 0;
+    if (!bcRun(bcf, 0, &r))
+    {
+        *failed = true;
+        bcWarnFallback(fd);
+        return NULL;
+    }
+
+    TypeFunction *tf = (TypeFunction *)fd->type->toBasetype();
+    if (bcf->retkind == BCnone)
+        return CTFEExp::voidexp;
+    return new IntegerExp(fd->loc, r, tf->next);
+}
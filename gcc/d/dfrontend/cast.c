@@ -88,6 +88,11 @@ Expression *implicitCastTo(Expression *e, Scope *sc, Type *t)
                 {
                     e->error("forward reference to type %s", t->toChars());
                 }
+                else if (global.diagnosticsGagged())
+                {
+                    // Don't bother formatting a message that is discarded.
+                    global.increaseErrorCount();
+                }
                 else
                 {
                     //printf("type %p ty %d deco %p\n", type, type->ty, type->deco);
@@ -19,6 +19,9 @@
 #include "arraytypes.h"
 #include "tokens.h"
 
+// Maximum allowable recursive function calls in CTFE
+#define CTFE_RECURSION_LIMIT 1000
+
 /**
    Global status of the CTFE engine. Mostly used for performance diagnostics
  */
@@ -31,7 +34,11 @@ struct CtfeStatus
     static int stackTraceCallsToSuppress;
     static int maxCallDepth; // highest number of recursive calls
     static int numArrayAllocs; // Number of allocated arrays
+    static d_uns64 numArrayBytes; // bytes allocated for array and struct literals
+    static d_uns64 numSharedElements; // scalar elements shared instead of copied
     static int numAssignments; // total number of assignments executed
+
+    static void printStats();
 };
 
 /**
@@ -274,5 +281,10 @@ Expression *ctfeIndex(Loc loc, Type *type, Expression *e1, uinteger_t indx);
 /// Cast 'e' of type 'type' to type 'to'.
 Expression *ctfeCast(Loc loc, Type *type, Type *to, Expression *e);
 
+/// Run fd with the interpreted 'arguments' on the bytecode engine.
+/// Returns NULL if fd is not supported, or needs the Interpreter to run.
+/// Sets *failed if it was run, but had to be abandoned partway.
+Expression *bcInterpret(FuncDeclaration *fd, Expressions *arguments, bool *failed);
+
 
 #endif /* DMD_CTFE_H */
@@ -228,11 +228,21 @@ bool needToCopyLiteral(Expression *expr)
     }
 }
 
+/* Scalar literals are never modified in place by CTFE, assignments
+ * replace them instead.  So they can be shared between the copies of
+ * an array or struct literal, instead of boxing a new value per element.
+ */
+static bool isSharedScalarLiteral(Expression *e)
+{
+    return e->op == TOKint64 || e->op == TOKfloat64 || e->op == TOKcomplex80;
+}
+
 Expressions *copyLiteralArray(Expressions *oldelems, Expression *basis = NULL)
 {
     if (!oldelems)
         return oldelems;
     CtfeStatus::numArrayAllocs++;
+    CtfeStatus::numArrayBytes += oldelems->dim * sizeof(Expression *);
     Expressions *newelems = new Expressions();
     newelems->setDim(oldelems->dim);
     for (size_t i = 0; i < oldelems->dim; i++)
@@ -240,7 +250,15 @@ Expressions *copyLiteralArray(Expressions *oldelems, Expression *basis = NULL)
         Expression *el = (*oldelems)[i];
         if (!el)
             el = basis;
-        (*newelems)[i] = copyLiteral(el).copy();
+        if (isSharedScalarLiteral(el))
+        {
+            CtfeStatus::numSharedElements++;
+            (*newelems)[i] = el;
+            continue;
+        }
+        el = copyLiteral(el).copy();
+        CtfeStatus::numArrayBytes += el->size;
+        (*newelems)[i] = el;
     }
     return newelems;
 }
@@ -254,6 +272,7 @@ UnionExp copyLiteral(Expression *e)
     {
         StringExp *se = (StringExp *)e;
         utf8_t *s = (utf8_t *)mem.xcalloc(se->len + 1, se->sz);
+        CtfeStatus::numArrayBytes += (se->len + 1) * se->sz;
         memcpy(s, se->string, se->len * se->sz);
         new(&ue) StringExp(se->loc, s, se->len);
         StringExp *se2 = (StringExp *)ue.exp();
@@ -296,6 +315,7 @@ UnionExp copyLiteral(Expression *e)
         Expressions *oldelems = sle->elements;
         Expressions * newelems = new Expressions();
         newelems->setDim(oldelems->dim);
+        CtfeStatus::numArrayBytes += oldelems->dim * sizeof(Expression *);
         for (size_t i = 0; i < newelems->dim; i++)
         {
             // We need the struct definition to detect block assignment
@@ -310,6 +330,11 @@ UnionExp copyLiteral(Expression *e)
             {
                 // Don't have to copy array references
             }
+            else if (isSharedScalarLiteral(m) && v->type->ty != Tsarray)
+            {
+                // Nor immutable scalar values
+                CtfeStatus::numSharedElements++;
+            }
             else
             {
                 // Buzilla 15681: Copy the source element always.
@@ -555,6 +580,7 @@ ArrayLiteralExp *createBlockDuplicatedArrayLiteral(Loc loc, Type *type,
 
     Expressions *elements = new Expressions();
     elements->setDim(dim);
+    CtfeStatus::numArrayBytes += dim * sizeof(Expression *);
     for (size_t i = 0; i < dim; i++)
     {
         (*elements)[i] = mustCopy ? copyLiteral(elem).copy() : elem;
@@ -573,6 +599,7 @@ StringExp *createBlockDuplicatedStringLiteral(Loc loc, Type *type,
         unsigned value, size_t dim, unsigned char sz)
 {
     utf8_t *s = (utf8_t *)mem.xcalloc(dim + 1, sz);
+    CtfeStatus::numArrayBytes += (dim + 1) * sz;
     for (size_t elemi = 0; elemi < dim; ++elemi)
     {
         switch (sz)
@@ -1731,6 +1758,7 @@ Expressions *changeOneElement(Expressions *oldelems, size_t indexToChange, Expre
 {
     Expressions *expsx = new Expressions();
     ++CtfeStatus::numArrayAllocs;
+    CtfeStatus::numArrayBytes += oldelems->dim * sizeof(Expression *);
     expsx->setDim(oldelems->dim);
     for (size_t j = 0; j < expsx->dim; j++)
     {
@@ -837,7 +837,8 @@ VarDeclaration::VarDeclaration(Loc loc, Type *type, Identifier *id, Initializer
     range = NULL;
 
     static unsigned nextSequenceNumber = 0;
-    this->sequenceNumber = ++nextSequenceNumber;
+    // Atomic, as the parser may create variables on several threads.
+    this->sequenceNumber = __sync_add_and_fetch(&nextSequenceNumber, 1);
 }
 
 Dsymbol *VarDeclaration::syntaxCopy(Dsymbol *s)
@@ -1512,6 +1513,13 @@ Lnomatch:
                         FuncDeclaration *f = ((FuncExp *)ex)->fd;
                         f->tookAddressOf--;
                     }
+                    else if (ex->op == TOKarrayliteral && global.params.vsafe &&
+                             !(storage_class & STCreturn) &&
+                             type->toBasetype()->ty == Tarray)
+                    {
+                        // or an array literal that can't escape the scope variable
+                        ((ArrayLiteralExp *)ex)->onstack = true;
+                    }
                 }
             }
             else
@@ -701,11 +701,19 @@ void Dsymbol::addMember(Scope *sc, ScopeDsymbol *sds)
     }
 }
 
+/* The name prefixed to diagnostics about this symbol, unless they
+ * aren't going to be printed.
+ */
+const char *Dsymbol::prettyCharsIfShown()
+{
+    return global.diagnosticsGagged() ? "" : toPrettyChars();
+}
+
 void Dsymbol::error(const char *format, ...)
 {
     va_list ap;
     va_start(ap, format);
-    ::verror(getLoc(), format, ap, kind(), toPrettyChars());
+    ::verror(getLoc(), format, ap, kind(), prettyCharsIfShown());
     va_end(ap);
 }
 
@@ -713,7 +721,7 @@ void Dsymbol::error(Loc loc, const char *format, ...)
 {
     va_list ap;
     va_start(ap, format);
-    ::verror(loc, format, ap, kind(), toPrettyChars());
+    ::verror(loc, format, ap, kind(), prettyCharsIfShown());
     va_end(ap);
 }
 
@@ -721,7 +729,7 @@ void Dsymbol::deprecation(Loc loc, const char *format, ...)
 {
     va_list ap;
     va_start(ap, format);
-    ::vdeprecation(loc, format, ap, kind(), toPrettyChars());
+    ::vdeprecation(loc, format, ap, kind(), prettyCharsIfShown());
     va_end(ap);
 }
 
@@ -729,7 +737,7 @@ void Dsymbol::deprecation(const char *format, ...)
 {
     va_list ap;
     va_start(ap, format);
-    ::vdeprecation(getLoc(), format, ap, kind(), toPrettyChars());
+    ::vdeprecation(getLoc(), format, ap, kind(), prettyCharsIfShown());
     va_end(ap);
 }
 
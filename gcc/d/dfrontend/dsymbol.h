@@ -179,6 +179,7 @@ public:
     const char *locToChars();
     bool equals(RootObject *o);
     bool isAnonymous();
+    const char *prettyCharsIfShown();
     void error(Loc loc, const char *format, ...);
     void error(const char *format, ...);
     void deprecation(Loc loc, const char *format, ...);
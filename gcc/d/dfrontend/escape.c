@@ -15,6 +15,13 @@
 #include "aggregate.h"
 #include "declaration.h"
 #include "module.h"
+#include "statement.h"
+#include "template.h"
+#include "visitor.h"
+#include "aav.h"
+
+bool walkPostorder(Expression *e, StoppableVisitor *v);
+bool walkPostorder(Statement *s, StoppableVisitor *v);
 
 /************************************
  * Aggregate the data collected by the escapeBy??() functions.
@@ -1149,3 +1156,319 @@ void findAllOuterAccessedVariables(FuncDeclaration *fd, VarDeclarations *vars)
         }
     }
 }
+
+/************************************
+ * A delegate variable local to a function, and how it is used.
+ */
+struct ScopeDelegateVar
+{
+    VarDeclaration *v;
+    size_t uses;        // number of times v is referenced
+    size_t safeuses;    // references that can't let the value of v escape
+};
+
+/* Walks over the body of a function to find local delegate variables
+ * that are only ever called, tested for null, assigned to, or passed
+ * to scope parameters.
+ */
+class ScopeDelegateVisitor : public StoppableVisitor
+{
+public:
+    FuncDeclaration *fd;
+    bool collecting;            // first pass, only look for discarded values
+    bool unknown;               // found something that can't be analyzed
+    AA *discarded;              // expressions whose value is not used
+    Array<ScopeDelegateVar> vars;
+    Expressions bindings;       // nested functions assigned to a local variable
+    VarDeclarations bindingvars;
+
+    ScopeDelegateVisitor(FuncDeclaration *fd)
+        : fd(fd), collecting(true), unknown(false), discarded(NULL)
+    {
+    }
+
+    /* Return the entry for v if it is a delegate local to fd
+     * that no nested function refers to.
+     */
+    ScopeDelegateVar *lookup(Declaration *d)
+    {
+        VarDeclaration *v = d->isVarDeclaration();
+        if (!v || collecting)
+            return NULL;
+
+        for (size_t i = 0; i < vars.dim; i++)
+        {
+            if (vars[i].v == v)
+                return &vars[i];
+        }
+
+        if (v->toParent2() != fd || v->isDataseg() || v->isParameter() ||
+            v->storage_class & (STCref | STCout | STClazy | STCscope | STCfield | STCmanifest) ||
+            v->nestedrefs.dim ||
+            !v->type || v->type->toBasetype()->ty != Tdelegate)
+        {
+            return NULL;
+        }
+
+        ScopeDelegateVar sv;
+        sv.v = v;
+        sv.uses = 0;
+        sv.safeuses = 0;
+        vars.push(sv);
+        return &vars[vars.dim - 1];
+    }
+
+    /* e is an operand whose value does not escape.
+     */
+    void safe(Expression *e)
+    {
+        if (e->op == TOKcast && e->type->toBasetype()->ty == Tdelegate)
+            e = ((CastExp *)e)->e1;
+        if (e->op != TOKvar)
+            return;
+
+        ScopeDelegateVar *sv = lookup(((VarExp *)e)->var);
+        if (sv)
+            sv->safeuses++;
+    }
+
+    void setDiscarded(Expression *e)
+    {
+        *dmd_aaGet(&discarded, (void *)e) = (void *)e;
+    }
+
+    bool isDiscarded(Expression *e)
+    {
+        return dmd_aaGetRvalue(discarded, (void *)e) != NULL;
+    }
+
+    /* Walk e, whose value is not used.
+     */
+    void discard(Expression *e)
+    {
+        if (!e)
+            return;
+        if (collecting)
+            setDiscarded(e);
+        walkPostorder(e, this);
+    }
+
+    void walk(Expression *e)
+    {
+        if (e)
+            walkPostorder(e, this);
+    }
+
+    void walkInit(VarDeclaration *v)
+    {
+        if (!v->_init || v->_init->isVoidInitializer())
+            return;
+
+        ExpInitializer *ie = v->_init->isExpInitializer();
+        if (ie)
+            discard(ie->exp);
+        else
+            unknown = true;
+    }
+
+    void visit(Expression *e)
+    {
+    }
+
+    void visit(SymbolExp *e)
+    {
+        ScopeDelegateVar *sv = lookup(e->var);
+        if (sv)
+            sv->uses++;
+    }
+
+    void visit(CommaExp *e)
+    {
+        if (collecting)
+            setDiscarded(e->e1);
+    }
+
+    void visit(DeclarationExp *e)
+    {
+        Dsymbol *s = e->declaration;
+        if (VarDeclaration *v = s->isVarDeclaration())
+        {
+            if (TupleDeclaration *td = v->toAlias()->isTupleDeclaration())
+            {
+                for (size_t i = 0; i < td->objects->dim; i++)
+                {
+                    Dsymbol *sx = isDsymbol((*td->objects)[i]);
+                    VarDeclaration *vx = sx ? sx->isVarDeclaration() : NULL;
+                    if (vx)
+                        walkInit(vx);
+                }
+            }
+            else
+                walkInit(v);
+        }
+    }
+
+    void visit(CastExp *e)
+    {
+        // if (dg)
+        if (e->to && e->to->toBasetype()->ty == Tbool)
+            safe(e->e1);
+    }
+
+    void visit(IdentityExp *e)
+    {
+        // dg is null
+        if (e->e2->op == TOKnull)
+            safe(e->e1);
+        else if (e->e1->op == TOKnull)
+            safe(e->e2);
+    }
+
+    void visit(CallExp *e)
+    {
+        // dg(args)
+        Type *t1 = e->e1->type ? e->e1->type->toBasetype() : NULL;
+        if (t1 && t1->ty == Tdelegate)
+            safe(e->e1);
+
+        if (!e->arguments || !t1)
+            return;
+
+        TypeFunction *tf = NULL;
+        if (t1->ty == Tfunction)
+            tf = (TypeFunction *)t1;
+        else if ((t1->ty == Tdelegate || t1->ty == Tpointer) && t1->nextOf()->ty == Tfunction)
+            tf = (TypeFunction *)t1->nextOf();
+        if (!tf)
+            return;
+
+        // foo(dg), where the parameter is scope
+        size_t nparams = Parameter::dim(tf->parameters);
+        for (size_t i = 0; i < e->arguments->dim && i < nparams; i++)
+        {
+            Parameter *p = Parameter::getNth(tf->parameters, i);
+            StorageClass stc = tf->parameterStorageClass(p);
+            if ((stc & STCscope) && !(stc & (STCref | STCout | STClazy | STCreturn)))
+                safe((*e->arguments)[i]);
+        }
+    }
+
+    void visit(AssignExp *e)
+    {
+        // dg = ...;
+        if (e->e1->op != TOKvar)
+            return;
+
+        VarExp *ve = (VarExp *)e->e1;
+        ScopeDelegateVar *sv = lookup(ve->var);
+        if (!sv || !isDiscarded(e))
+            return;
+        sv->safeuses++;
+
+        Expression *e2 = e->e2;
+        if (e2->op == TOKcast)
+            e2 = ((CastExp *)e2)->e1;
+
+        FuncDeclaration *f = NULL;
+        if (e2->op == TOKfunction)
+            f = ((FuncExp *)e2)->fd;
+        else if (e2->op == TOKdelegate)
+        {
+            DelegateExp *de = (DelegateExp *)e2;
+            if (de->e1->op == TOKvar)
+                f = ((VarExp *)de->e1)->var->isFuncDeclaration();
+        }
+
+        if (f && f->isNested() && f->toParent2() == fd)
+        {
+            for (size_t i = 0; i < bindings.dim; i++)
+            {
+                if (bindings[i] == e2)
+                    return;
+            }
+            bindings.push(e2);
+            bindingvars.push(sv->v);
+        }
+    }
+};
+
+class ScopeDelegateStatementVisitor : public StoppableVisitor
+{
+public:
+    ScopeDelegateVisitor *v;
+    ScopeDelegateStatementVisitor(ScopeDelegateVisitor *v) : v(v) {}
+
+    void visit(Statement *s)                { }
+    void visit(ExpStatement *s)             { v->discard(s->exp); }
+    void visit(WhileStatement *s)           { v->walk(s->condition); }
+    void visit(DoStatement *s)              { v->walk(s->condition); }
+    void visit(ForStatement *s)             { v->walk(s->condition); v->discard(s->increment); }
+    void visit(IfStatement *s)              { v->walk(s->condition); }
+    void visit(SwitchStatement *s)          { v->walk(s->condition); }
+    void visit(CaseStatement *s)            { v->walk(s->exp); }
+    void visit(ReturnStatement *s)          { v->walk(s->exp); }
+    void visit(SynchronizedStatement *s)    { v->walk(s->exp); }
+    void visit(WithStatement *s)            { if (s->wthis) v->walkInit(s->wthis); else v->walk(s->exp); }
+    void visit(ThrowStatement *s)           { v->walk(s->exp); }
+
+    // Should have been lowered by semantic, or can refer to anything.
+    void visit(ForeachStatement *s)         { v->unknown = true; }
+    void visit(ForeachRangeStatement *s)    { v->unknown = true; }
+    void visit(CompileStatement *s)         { v->unknown = true; }
+    void visit(ConditionalStatement *s)     { v->unknown = true; }
+    void visit(AsmStatement *s)             { v->unknown = true; }
+#ifdef IN_GCC
+    void visit(ExtAsmStatement *s)          { v->unknown = true; }
+#endif
+};
+
+/*************************
+ * The address of a nested function that is assigned to a local delegate,
+ * which is only ever called, compared with null, or passed to scope
+ * parameters, can't outlive the function's stack frame. So such nested
+ * functions don't require a closure to be allocated for fd.
+ * Params:
+ *      fd = function whose body has had semantic run on it
+ */
+void inferScopeDelegates(FuncDeclaration *fd)
+{
+    if (!fd->fbody)
+        return;
+
+    ScopeDelegateVisitor v(fd);
+    ScopeDelegateStatementVisitor sv(&v);
+
+    // First find the values which are unused, then look at the uses of delegates.
+    walkPostorder(fd->fbody, &sv);
+    v.collecting = false;
+    walkPostorder(fd->fbody, &sv);
+
+    if (v.unknown)
+        return;
+
+    for (size_t i = 0; i < v.bindings.dim; i++)
+    {
+        for (size_t j = 0; j < v.vars.dim; j++)
+        {
+            ScopeDelegateVar *var = &v.vars[j];
+            if (var->v != v.bindingvars[i] || var->uses != var->safeuses)
+                continue;
+
+            Expression *e = v.bindings[i];
+            if (e->op == TOKfunction)
+            {
+                /* Function literals can only appear once, so if this
+                 * appearance doesn't escape, there cannot be any others.
+                 */
+                ((FuncExp *)e)->fd->tookAddressOf = 0;
+            }
+            else
+            {
+                FuncDeclaration *f = ((VarExp *)((DelegateExp *)e)->e1)->var->isFuncDeclaration();
+                if (f->tookAddressOf > 0)
+                    f->tookAddressOf--;
+            }
+            break;
+        }
+    }
+}
@@ -1849,6 +1849,16 @@ bool functionParameters(Loc loc, Scope *sc, TypeFunction *tf,
                         }
                     }
                 }
+                else if (a->op == TOKarrayliteral && global.params.vsafe &&
+                         !(tf->parameterStorageClass(p) & STCreturn))
+                {
+                    /* A dynamic array literal passed to a scope parameter
+                     * can be allocated on the stack, as the callee is
+                     * checked not to let it escape.
+                     */
+                    if (a->type->toBasetype()->ty == Tarray)
+                        ((ArrayLiteralExp *)a)->onstack = true;
+                }
             }
             arg = arg->optimize(WANTvalue, (p->storageClass & (STCref | STCout)) != 0);
         }
@@ -4310,6 +4320,7 @@ ArrayLiteralExp::ArrayLiteralExp(Loc loc, Expressions *elements)
     this->basis = NULL;
     this->elements = elements;
     this->ownedByCtfe = OWNEDcode;
+    this->onstack = false;
 }
 
 ArrayLiteralExp::ArrayLiteralExp(Loc loc, Expression *e)
@@ -4319,6 +4330,7 @@ ArrayLiteralExp::ArrayLiteralExp(Loc loc, Expression *e)
     elements = new Expressions;
     elements->push(e);
     this->ownedByCtfe = OWNEDcode;
+    this->onstack = false;
 }
 
 ArrayLiteralExp::ArrayLiteralExp(Loc loc, Expression *basis, Expressions *elements)
@@ -4327,6 +4339,7 @@ ArrayLiteralExp::ArrayLiteralExp(Loc loc, Expression *basis, Expressions *elemen
     this->basis = basis;
     this->elements = elements;
     this->ownedByCtfe = OWNEDcode;
+    this->onstack = false;
 }
 
 bool ArrayLiteralExp::equals(RootObject *o)
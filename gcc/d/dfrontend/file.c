@@ -31,6 +31,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <utime.h>
+#include <sys/mman.h>
 #endif
 
 #include "filename.h"
@@ -61,16 +62,26 @@ File::File(const char *n)
 }
 
 File::~File()
+{
+    freeBuffer();
+}
+
+void File::freeBuffer()
 {
     if (buffer)
     {
         if (ref == 0)
             mem.xfree(buffer);
-#if _WIN32
+#if POSIX
+        if (ref == 2)
+            munmap(buffer, len);
+#elif _WIN32
         if (ref == 2)
             UnmapViewOfFile(buffer);
 #endif
     }
+    buffer = NULL;
+    len = 0;
 }
 
 /*************************************
@@ -190,6 +201,57 @@ err1:
 #endif
 }
 
+/*********************************************
+ * Map the file read-only into memory.
+ * The lexer needs two 0 bytes past the end of the text.  Those are
+ * taken from the zero fill of the last page, so files that end too
+ * close to a page boundary are read instead, as are small files,
+ * for which a read is cheaper than setting up a mapping.
+ * Returns:
+ *      true if error
+ */
+
+bool File::mmread()
+{
+    if (len)
+        return false;               // already read the file
+#if POSIX
+    const char *name = this->name->toChars();
+    int fd = open(name, O_RDONLY);
+    if (fd == -1)
+        return true;
+
+    struct stat buf;
+    if (fstat(fd, &buf) || !S_ISREG(buf.st_mode))
+    {
+        close(fd);
+        return read();
+    }
+
+    size_t size = (size_t)buf.st_size;
+    size_t pagesize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t tail = size % pagesize;
+    if (size < 4 * pagesize || tail == 0 || tail > pagesize - 2)
+    {
+        close(fd);
+        return read();
+    }
+
+    void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return read();
+
+    freeBuffer();
+    buffer = (unsigned char *)p;
+    len = size;
+    ref = 2;
+    return false;
+#else
+    return read();
+#endif
+}
+
 /*********************************************
  * Write a file.
  * Returns:
@@ -25,6 +25,7 @@ struct FileName;
 struct File
 {
     int ref;                    // != 0 if this is a reference to someone else's buffer
+                                // 2 if buffer is a memory mapped view of the file
     unsigned char *buffer;      // data for our file
     size_t len;                 // amount of data in buffer[]
 
@@ -42,6 +43,12 @@ struct File
 
     bool read();
 
+    /* Map file read-only into memory, return true if error.
+     * Like read(), the buffer is followed by two 0 bytes.
+     */
+
+    bool mmread();
+
     /* Write file, return true if error
      */
 
@@ -56,6 +63,7 @@ struct File
         this->len = len;
     }
 
+    void freeBuffer();          // free or unmap buffer if we own it
     void remove();              // delete file
 };
 
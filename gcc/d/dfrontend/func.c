@@ -35,6 +35,7 @@
 Expression *addInvariant(Loc loc, Scope *sc, AggregateDeclaration *ad, VarDeclaration *vthis, bool direct);
 bool checkEscape(Scope *sc, Expression *e, bool gag);
 bool checkEscapeRef(Scope *sc, Expression *e, bool gag);
+void inferScopeDelegates(FuncDeclaration *fd);
 bool checkNestedRef(Dsymbol *s, Dsymbol *p);
 Statement *semantic(Statement *s, Scope *sc);
 void semantic(Catch *c, Scope *sc);
@@ -2118,6 +2119,12 @@ void FuncDeclaration::semantic3(Scope *sc)
         sc2->pop();
     }
 
+    /* Nested functions whose address is only kept in local delegates
+     * that are called, but never escape, don't need a closure.
+     */
+    if (fbody && global.errors == oldErrors)
+        inferScopeDelegates(this);
+
     if (checkClosure())
     {
         //errors = true;
@@ -3393,6 +3400,16 @@ FuncDeclaration *resolveFuncCall(Loc loc, Scope *sc, Dsymbol *s,
     if (td && td->funcroot)
         s = fd = td->funcroot;
 
+    /* When gagged the message is thrown away, so only count the error
+     * rather than spelling out the argument types and candidates.
+     */
+    if (global.diagnosticsGagged())
+    {
+        if (m.lastf ? m.nextf != NULL : !(flags & 1))
+            global.increaseErrorCount();
+        return NULL;
+    }
+
     OutBuffer tiargsBuf;
     arrayObjectsToBuffer(&tiargsBuf, tiargs);
 
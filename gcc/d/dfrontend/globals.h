@@ -32,6 +32,13 @@ enum BOUNDSCHECK
     BOUNDSCHECKsafeonly // do bounds checking only in @safe functions
 };
 
+// The engine used for compile time function evaluation
+enum CTFEENGINE
+{
+    CTFEENGINEast,      // interpret the AST directly
+    CTFEENGINEbytecode  // compile integral functions to bytecode first
+};
+
 enum CPU
 {
     x87,
@@ -116,9 +123,12 @@ struct Param
     bool bug10378;      // use pre-bugzilla 10378 search strategy
     bool vsafe;         // use enhanced @safe checking
     bool showGaggedErrors;  // print gagged errors anyway
+    bool timeTrace;     // write a trace of where compile time is spent
+    bool warnCtfeFallback;  // warn about functions the bytecode engine can't run
 
     CPU cpu;                // CPU instruction set to target
     BOUNDSCHECK useArrayBounds;
+    CTFEENGINE ctfeEngine;
 
     const char *argv0;    // program name
     Array<const char *> *modFileAliasStrings; // array of char*'s of -I module filename alias strings
@@ -154,6 +164,11 @@ struct Param
     const char *moduleDepsFile; // filename for deps output
     OutBuffer *moduleDeps;      // contents to be written to deps file
 
+    const char *moduleCacheDir; // directory for the token cache of imported modules
+
+    const char *timeTraceFile;  // filename for the time trace
+    unsigned timeTraceGranularity; // shortest event in the time trace, in microseconds
+
     // Hidden debug switches
     bool debugb;
     bool debugc;
@@ -233,6 +248,12 @@ struct Global
      */
     void increaseErrorCount();
 
+    /*  Return true if diagnostics raised now are discarded, as when
+     *  compiling speculatively. Callers can then skip building message
+     *  arguments that are expensive, and only increaseErrorCount().
+     */
+    bool diagnosticsGagged();
+
     void _init();
 };
 
@@ -99,11 +99,38 @@ int Identifier::dyncast() const
 }
 
 StringTable Identifier::stringtable;
+THREAD_LOCAL StringTable *Identifier::threadtable;
+THREAD_LOCAL size_t Identifier::parseUnit;
+THREAD_LOCAL size_t Identifier::parseUnitIds;
+
+// Protects stringtable when modules are parsed in parallel.
+static SpinLock stringtableLock;
+
+/********************************************
+ * Number identifiers generated from now on by this thread per unit,
+ * rather than from the global counter.  Used when parsing modules in
+ * parallel, so the names don't depend on thread scheduling.
+ * Pass 0 to go back to the global counter.
+ */
+
+void Identifier::beginParseUnit(size_t unit)
+{
+    parseUnit = unit;
+    parseUnitIds = 0;
+}
 
 Identifier *Identifier::generateId(const char *prefix)
 {
     static size_t i;
 
+    if (parseUnit)
+    {
+        // The '_' separator keeps these distinct from the ids numbered below.
+        OutBuffer buf;
+        buf.writestring(prefix);
+        buf.printf("%llu_%llu", (ulonglong)parseUnit, (ulonglong)++parseUnitIds);
+        return idPool(buf.peekString());
+    }
     return generateId(prefix, ++i);
 }
 
@@ -128,6 +155,15 @@ Identifier *Identifier::idPool(const char *s)
 
 Identifier *Identifier::idPool(const char *s, size_t len)
 {
+    // Parser threads look in their own cache first, to keep the
+    // shared table lock uncontended.
+    if (threadtable)
+    {
+        if (StringValue *sv = threadtable->lookup(s, len))
+            return (Identifier *) sv->ptrvalue;
+    }
+
+    stringtableLock.lock();
     StringValue *sv = stringtable.update(s, len);
     Identifier *id = (Identifier *) sv->ptrvalue;
     if (!id)
@@ -135,15 +171,21 @@ Identifier *Identifier::idPool(const char *s, size_t len)
         id = new Identifier(sv->toDchars(), len, TOKidentifier);
         sv->ptrvalue = (char *)id;
     }
+    stringtableLock.unlock();
+
+    if (threadtable)
+        threadtable->insert(s, len, id);
     return id;
 }
 
 Identifier *Identifier::idPool(const char *s, size_t len, int value)
 {
+    stringtableLock.lock();
     StringValue *sv = stringtable.insert(s, len, NULL);
     assert(sv);
     Identifier *id = new Identifier(sv->toDchars(), len, value);
     sv->ptrvalue = (char *)id;
+    stringtableLock.unlock();
     return id;
 }
 
@@ -184,7 +226,9 @@ Linvalid:
 
 Identifier *Identifier::lookup(const char *s, size_t len)
 {
+    stringtableLock.lock();
     StringValue *sv = stringtable.lookup(s, len);
+    stringtableLock.unlock();
     if (!sv)
         return NULL;
     return (Identifier *)sv->ptrvalue;
@@ -39,6 +39,10 @@ public:
     int dyncast() const;
 
     static StringTable stringtable;
+    static THREAD_LOCAL StringTable *threadtable;  // cache of stringtable for parser threads
+    static THREAD_LOCAL size_t parseUnit;           // numbering of generated ids in parser threads
+    static THREAD_LOCAL size_t parseUnitIds;
+    static void beginParseUnit(size_t unit);
     static Identifier *generateId(const char *prefix);
     static Identifier *generateId(const char *prefix, size_t i);
     static Identifier *idPool(const char *s);
@@ -31,6 +31,7 @@
 
 #include "template.h"
 #include "ctfe.h"
+#include "timetrace.h"
 
 /* Interpreter: what form of return value expression is required?
  */
@@ -50,9 +51,6 @@ Expression *interpret(Expression *e, InterState *istate, CtfeGoal goal = ctfeNee
 #define LOGCOMPILE 0
 #define SHOWPERFORMANCE 0
 
-// Maximum allowable recursive function calls in CTFE
-#define CTFE_RECURSION_LIMIT 1000
-
 /**
   The values of all CTFE variables
 */
@@ -254,15 +252,26 @@ int CtfeStatus::callDepth = 0;
 int CtfeStatus::stackTraceCallsToSuppress = 0;
 int CtfeStatus::maxCallDepth = 0;
 int CtfeStatus::numArrayAllocs = 0;
+d_uns64 CtfeStatus::numArrayBytes = 0;
+d_uns64 CtfeStatus::numSharedElements = 0;
 int CtfeStatus::numAssignments = 0;
 
+// Print memory statistics for -v.
+void CtfeStatus::printStats()
+{
+    fprintf(global.stdmsg, "ctfe      %d array allocs, %llu bytes, %llu shared elements\n",
+        numArrayAllocs, (unsigned long long)numArrayBytes,
+        (unsigned long long)numSharedElements);
+}
+
 // CTFE diagnostic information
 void printCtfePerformanceStats()
 {
 #if SHOWPERFORMANCE
     printf("        ---- CTFE Performance ----\n");
     printf("max call depth = %d\tmax stack = %d\n", CtfeStatus::maxCallDepth, ctfeStack.maxStackUsage());
-    printf("array allocs = %d\tassignments = %d\n\n", CtfeStatus::numArrayAllocs, CtfeStatus::numAssignments);
+    printf("array allocs = %d\tarray bytes = %llu\tassignments = %d\n\n", CtfeStatus::numArrayAllocs,
+        (unsigned long long)CtfeStatus::numArrayBytes, CtfeStatus::numAssignments);
 #endif
 }
 
@@ -811,6 +820,23 @@ Expression *ctfeInterpretForPragmaMsg(Expression *e)
     return e;
 }
 
+/*************************************
+ * While fd is run by the Interpreter after the bytecode engine abandoned
+ * it, the functions it calls are not tried as bytecode.
+ */
+
+struct BytecodeFallback
+{
+    static int depth;           // number of such functions being run
+    bool active;
+
+    BytecodeFallback() : active(false) { }
+    void begin() { active = true; depth++; }
+    ~BytecodeFallback() { if (active) depth--; }
+};
+
+int BytecodeFallback::depth = 0;
+
 /*************************************
  * Attempt to interpret a function given the arguments.
  * Input:
@@ -837,6 +863,8 @@ Expression *interpret(FuncDeclaration *fd, InterState *istate, Expressions *argu
     if (fd->semanticRun < PASSsemantic3done)
         return CTFEExp::cantexp;
 
+    TimeTraceScope trace("CTFE call", fd);
+
     // CTFE-compile the function
     if (!fd->ctfeCode)
         ctfeCompile(fd);
@@ -928,6 +956,23 @@ Expression *interpret(FuncDeclaration *fd, InterState *istate, Expressions *argu
         eargs[i] = earg;
     }
 
+    /* Functions only operating on integers may be run as bytecode.
+     * If that is abandoned partway, the calls made while fd is run again
+     * by the Interpreter aren't tried as bytecode, as they would mostly
+     * be abandoned the same way, making a deep call tree quadratic.
+     */
+    BytecodeFallback fallback;
+    if (global.params.ctfeEngine == CTFEENGINEbytecode && !thisarg &&
+        !BytecodeFallback::depth)
+    {
+        bool failed;
+        Expression *e = bcInterpret(fd, &eargs, &failed);
+        if (e)
+            return e;
+        if (failed)
+            fallback.begin();
+    }
+
     // Now that we've evaluated all the arguments, we can start the frame
     // (this is the moment when the 'call' actually takes place).
     InterState istatex;
@@ -2665,6 +2710,7 @@ public:
                 {
                     expsx = new Expressions();
                     ++CtfeStatus::numArrayAllocs;
+                    CtfeStatus::numArrayBytes += e->exps->dim * sizeof(Expression *);
                     expsx->setDim(e->exps->dim);
                     for (size_t j = 0; j < i; j++)
                     {
@@ -2740,6 +2786,7 @@ public:
             {
                 expsx = new Expressions();
                 ++CtfeStatus::numArrayAllocs;
+                CtfeStatus::numArrayBytes += dim * sizeof(Expression *);
                 expsx->setDim(dim);
                 for (size_t j = 0; j < i; j++)
                 {
@@ -2927,6 +2974,7 @@ public:
                 {
                     expsx = new Expressions();
                     ++CtfeStatus::numArrayAllocs;
+                    CtfeStatus::numArrayBytes += e->sd->fields.dim * sizeof(Expression *);
                     expsx->setDim(e->sd->fields.dim);
                     for (size_t j = 0; j < e->elements->dim; j++)
                     {
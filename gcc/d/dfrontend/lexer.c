@@ -21,12 +21,20 @@
 #include <assert.h>
 #include <time.h>       // for time() and ctime()
 
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>  // for the scanning fast paths
+#define LEXER_SSE2 1
+#else
+#define LEXER_SSE2 0
+#endif
+
 #include "rmem.h"
 
 #include "lexer.h"
 #include "utf.h"
 #include "identifier.h"
 #include "id.h"
+#include "modcache.h"
 
 extern int HtmlNamedEntity(const utf8_t *p, size_t length);
 
@@ -62,9 +70,229 @@ static void cmtable_init()
     }
 }
 
+/********************************************
+ * Fast paths for skipping runs of characters that need no special
+ * handling. Where SSE2 is available, 16 characters are tested at a time.
+ * Each returns a pointer to the first character in [p, end) that the
+ * caller has to look at, or end if there is none.
+ */
+
+/* Skip spaces and tabs.
+ */
+static const utf8_t *skipBlanks(const utf8_t *p, const utf8_t *end)
+{
+    // Most runs are a single blank, don't load a vector for those.
+    if (p < end && *p != ' ' && *p != '\t')
+        return p;
+#if LEXER_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    while (end - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab));
+        unsigned mask = ~_mm_movemask_epi8(m) & 0xFFFF;
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+/* Skip ASCII identifier characters.
+ */
+static const utf8_t *skipIdChars(const utf8_t *p, const utf8_t *end)
+{
+    if (p < end && !isidchar(*p))
+        return p;
+#if LEXER_SSE2
+    while (end - p >= 16)
+    {
+        // Non-ASCII bytes compare as negative, so fall outside all ranges.
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                      _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                      _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+        __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+        __m128i m = _mm_or_si128(_mm_or_si128(alpha, digit), under);
+        unsigned mask = ~_mm_movemask_epi8(m) & 0xFFFF;
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && isidchar(*p))
+        p++;
+    return p;
+}
+
+/* Skip printable ASCII characters other than c1 and c2. This stops at
+ * line endings, the end of file and the start of any UTF-8 sequence.
+ */
+static const utf8_t *skipPlain(const utf8_t *p, const utf8_t *end, utf8_t c1, utf8_t c2)
+{
+#if LEXER_SSE2
+    const __m128i v1 = _mm_set1_epi8(c1);
+    const __m128i v2 = _mm_set1_epi8(c2);
+    while (end - p >= 16)
+    {
+        // Non-ASCII bytes compare as negative, so less than ' '.
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i m = _mm_cmplt_epi8(v, _mm_set1_epi8(' '));
+        m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, v1), _mm_cmpeq_epi8(v, v2)));
+        unsigned mask = _mm_movemask_epi8(m);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p >= ' ' && *p < 0x80 && *p != c1 && *p != c2)
+        p++;
+    return p;
+}
+
+#if LEXER_BENCHMARK
+
+/* Micro-benchmark of the scanning fast paths against the plain loops
+ * they replace, build with:
+ *   g++ -O2 -DLEXER_BENCHMARK -I. -I.. lexer.c outbuffer.c rmem.c -o lexbench
+ *   ./lexbench ../../../libphobos/src/std/*.d
+ *
+ * Each file is walked the way the lexer walks it: runs of blanks,
+ * identifiers, // comments, block comments and string literals are
+ * skipped, everything else is stepped over one character at a time.
+ * Without arguments a synthetic corpus is used.
+ */
+
+static const utf8_t *scalarBlanks(const utf8_t *p, const utf8_t *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+static const utf8_t *scalarIdChars(const utf8_t *p, const utf8_t *end)
+{
+    while (p < end && isidchar(*p))
+        p++;
+    return p;
+}
+
+static const utf8_t *scalarPlain(const utf8_t *p, const utf8_t *end, utf8_t c1, utf8_t c2)
+{
+    while (p < end && *p >= ' ' && *p < 0x80 && *p != c1 && *p != c2)
+        p++;
+    return p;
+}
+
+template<bool fast>
+static size_t scan(const utf8_t *p, const utf8_t *end)
+{
+    size_t steps = 0;
+    while (p < end)
+    {
+        utf8_t c = *p;
+        utf8_t c1 = p + 1 < end ? p[1] : 0;
+        if (c == ' ' || c == '\t')
+            p = fast ? skipBlanks(p + 1, end) : scalarBlanks(p + 1, end);
+        else if (isidchar(c))
+            p = fast ? skipIdChars(p + 1, end) : scalarIdChars(p + 1, end);
+        else if (c == '/' && c1 == '/')
+            p = fast ? skipPlain(p + 2, end, 0, 0) : scalarPlain(p + 2, end, 0, 0);
+        else if (c == '/' && c1 == '*')
+            p = fast ? skipPlain(p + 2, end, '/', '/') : scalarPlain(p + 2, end, '/', '/');
+        else if (c == '"')
+            p = fast ? skipPlain(p + 1, end, '"', '\\') : scalarPlain(p + 1, end, '"', '\\');
+        else
+            p++;
+        steps++;
+    }
+    return steps;
+}
+
+static double elapsed(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void append(OutBuffer *buf, const char *s)
+{
+    buf->write(s, strlen(s));
+}
+
+int main(int argc, char **argv)
+{
+    cmtable_init();
+
+    OutBuffer corpus;
+    for (int i = 1; i < argc; i++)
+    {
+        FILE *f = fopen(argv[i], "rb");
+        if (!f)
+        {
+            perror(argv[i]);
+            return 1;
+        }
+        char chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) != 0)
+            corpus.write(chunk, n);
+        fclose(f);
+    }
+    if (argc == 1)
+    {
+        for (int i = 0; i < 20000; i++)
+        {
+            append(&corpus, "/* Return the sum of the elements of the range,\n"
+                            " * starting from the given seed value.\n"
+                            " */\n");
+            append(&corpus, "auto sumElements(Range, Seed)(Range range, Seed seed)\n{\n");
+            append(&corpus, "    // Add every element to the accumulator in turn.\n");
+            append(&corpus, "    foreach (element; range)\n");
+            append(&corpus, "        seed += element;\n");
+            append(&corpus, "    enforce(seed >= 0, \"negative sum of range elements\\n\");\n");
+            append(&corpus, "    return seed;\n}\n\n");
+        }
+    }
+
+    const utf8_t *base = (const utf8_t *)corpus.data;
+    const utf8_t *end = base + corpus.offset;
+    const int reps = 20;
+    double mb = (double)corpus.offset * reps / (1024 * 1024);
+
+    size_t nscalar = 0;
+    clock_t start = clock();
+    for (int n = 0; n < reps; n++)
+        nscalar += scan<false>(base, end);
+    double tscalar = elapsed(start);
+
+    size_t nfast = 0;
+    start = clock();
+    for (int n = 0; n < reps; n++)
+        nfast += scan<true>(base, end);
+    double tfast = elapsed(start);
+
+    printf("%u bytes, %s\n", (unsigned)corpus.offset,
+           LEXER_SSE2 ? "SSE2" : "no SSE2, both loops are scalar");
+    printf("scalar loops: %.3fs  %.1f MB/s\n", tscalar, mb / tscalar);
+    printf("fast paths:   %.3fs  %.1f MB/s\n", tfast, mb / tfast);
+    if (nscalar != nfast)
+    {
+        printf("mismatch: %u steps vs %u steps\n", (unsigned)nscalar, (unsigned)nfast);
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
 /*************************** Lexer ********************************************/
 
-OutBuffer Lexer::stringbuffer;
 
 Lexer::Lexer(const char *filename,
         const utf8_t *base, size_t begoffset, size_t endoffset,
@@ -82,6 +310,7 @@ Lexer::Lexer(const char *filename,
     this->anyToken = 0;
     this->commentToken = commentToken;
     this->errors = false;
+    this->tokcache = NULL;
     //initKeywords();
 
     /* If first line starts with '#!', ignore the line
@@ -157,6 +386,8 @@ void Lexer::deprecation(const char *format, ...)
     va_end(ap);
     if (global.params.useDeprecated == 0)
         errors = true;
+    if (tokcache)
+        tokcache->cacheable = false;
 }
 
 TOK Lexer::nextToken()
@@ -169,7 +400,7 @@ TOK Lexer::nextToken()
     }
     else
     {
-        scan(&token);
+        scanToken(&token);
     }
     //token.print();
     return token.value;
@@ -183,7 +414,7 @@ Token *Lexer::peek(Token *ct)
     else
     {
         t = Token::alloc();
-        scan(t);
+        scanToken(t);
         ct->next = t;
     }
     return t;
@@ -259,6 +490,23 @@ Token *Lexer::peekPastParen(Token *tk)
     }
 }
 
+/****************************
+ * Get the next token of the token stream, either from the module
+ * cache, or by scanning the buffer.
+ */
+
+void Lexer::scanToken(Token *t)
+{
+    if (tokcache && tokcache->replaying)
+    {
+        tokcache->read(t);
+        return;
+    }
+    scan(t);
+    if (tokcache)
+        tokcache->write(t);
+}
+
 /****************************
  * Turn next token in buffer into a token.
  */
@@ -286,7 +534,7 @@ void Lexer::scan(Token *t)
             case '\t':
             case '\v':
             case '\f':
-                p++;
+                p = skipBlanks(p + 1, end);
                 continue;                       // skip white space
 
             case '\r':
@@ -362,10 +610,9 @@ void Lexer::scan(Token *t)
 
                 while (1)
                 {
-                    c = *++p;
-                    if (isidchar(c))
-                        continue;
-                    else if (c & 0x80)
+                    p = skipIdChars(p + 1, end);
+                    c = *p;
+                    if (c & 0x80)
                     {   const utf8_t *s = p;
                         unsigned u = decodeUTF();
                         if (isUniAlpha(u))
@@ -382,23 +629,33 @@ void Lexer::scan(Token *t)
                 anyToken = 1;
                 if (*t->ptr == '_')     // if special identifier token
                 {
-                    static bool initdone = false;
+                    static volatile bool initdone = false;
+                    static SpinLock initlock;
                     static char date[11+1];
                     static char time[8+1];
                     static char timestamp[24+1];
 
                     if (!initdone)       // lazy evaluation
                     {
-                        initdone = true;
-                        time_t ct;
-                        ::time(&ct);
-                        char *p = ctime(&ct);
-                        assert(p);
-                        sprintf(&date[0], "%.6s %.4s", p + 4, p + 20);
-                        sprintf(&time[0], "%.8s", p + 11);
-                        sprintf(&timestamp[0], "%.24s", p);
+                        initlock.lock();
+                        if (!initdone)
+                        {
+                            time_t ct;
+                            ::time(&ct);
+                            char *p = ctime(&ct);
+                            assert(p);
+                            sprintf(&date[0], "%.6s %.4s", p + 4, p + 20);
+                            sprintf(&time[0], "%.8s", p + 11);
+                            sprintf(&timestamp[0], "%.24s", p);
+                            __sync_synchronize();
+                            initdone = true;
+                        }
+                        initlock.unlock();
                     }
 
+                    if (tokcache && (id == Id::DATE || id == Id::TIME || id == Id::TIMESTAMP))
+                        tokcache->cacheable = false;
+
                     if (id == Id::DATE)
                     {
                         t->ustring = (utf8_t *)date;
@@ -473,7 +730,8 @@ void Lexer::scan(Token *t)
                         while (1)
                         {
                             while (1)
-                            {   utf8_t c = *p;
+                            {   p = skipPlain(p, end, '/', '/');
+                                utf8_t c = *p;
                                 switch (c)
                                 {
                                     case '/':
@@ -528,7 +786,8 @@ void Lexer::scan(Token *t)
                     case '/':           // do // style comments
                         startLoc = loc();
                         while (1)
-                        {   utf8_t c = *++p;
+                        {   p = skipPlain(p + 1, end, 0, 0);
+                            utf8_t c = *p;
                             switch (c)
                             {
                                 case '\n':
@@ -588,7 +847,8 @@ void Lexer::scan(Token *t)
                         p++;
                         nest = 1;
                         while (1)
-                        {   utf8_t c = *p;
+                        {   p = skipPlain(p, end, '/', '+');
+                            utf8_t c = *p;
                             switch (c)
                             {
                                 case '/':
@@ -1086,6 +1346,10 @@ TOK Lexer::wysiwygStringConstant(Token *t, int tc)
     stringbuffer.reset();
     while (1)
     {
+        const utf8_t *s = skipPlain(p, end, tc, tc);
+        stringbuffer.write(p, s - p);
+        p = s;
+
         c = *p++;
         switch (c)
         {
@@ -1443,6 +1707,10 @@ TOK Lexer::escapeStringConstant(Token *t, int wide)
     stringbuffer.reset();
     while (1)
     {
+        const utf8_t *s = skipPlain(p, end, '"', '\\');
+        stringbuffer.write(p, s - p);
+        p = s;
+
         c = *p++;
         switch (c)
         {
@@ -2005,21 +2273,32 @@ TOK Lexer::inreal(Token *t)
     const char *sbufptr = (char *)stringbuffer.data;
     TOK result;
     bool isOutOfRange = false;
+
+    /* The conversion goes through GCC's real.c and MPFR, which are not
+     * thread safe, so only one parser thread may be converting at a time.
+     */
+    static SpinLock convertlock;
+    convertlock.lock();
     t->floatvalue = (isWellformedString ? CTFloat::parse(sbufptr, &isOutOfRange) : CTFloat::zero);
+    if (isWellformedString && !isOutOfRange)
+    {
+        if (*p == 'F' || *p == 'f')
+            isOutOfRange = Port::isFloat32LiteralOutOfRange(sbufptr);
+        else if (*p != 'L' && *p != 'l')
+            isOutOfRange = Port::isFloat64LiteralOutOfRange(sbufptr);
+    }
+    convertlock.unlock();
+
     errno = 0;
     switch (*p)
     {
         case 'F':
         case 'f':
-            if (isWellformedString && !isOutOfRange)
-                isOutOfRange = Port::isFloat32LiteralOutOfRange(sbufptr);
             result = TOKfloat32v;
             p++;
             break;
 
         default:
-            if (isWellformedString && !isOutOfRange)
-                isOutOfRange = Port::isFloat64LiteralOutOfRange(sbufptr);
             result = TOKfloat64v;
             break;
 
@@ -2451,3 +2730,5 @@ void unittest_lexer()
 }
 
 #endif
+
+#endif
@@ -22,11 +22,12 @@
 
 struct StringTable;
 class Identifier;
+class TokenCache;
 
 class Lexer
 {
 public:
-    static OutBuffer stringbuffer;
+    OutBuffer stringbuffer;     // per lexer, so modules can be lexed in parallel
 
     Loc scanloc;                // for error messages
 
@@ -39,6 +40,7 @@ public:
     int anyToken;               // !=0 means seen at least one token
     int commentToken;           // !=0 means comments are TOKcomment's
     bool errors;                // errors occurred during lexing or parsing
+    TokenCache *tokcache;       // if set, read tokens from or write them to the module cache
 
     Lexer(const char *filename,
         const utf8_t *base, size_t begoffset, size_t endoffset,
@@ -49,6 +51,7 @@ public:
     TOK nextToken();
     TOK peekNext();
     TOK peekNext2();
+    void scanToken(Token *t);
     void scan(Token *t);
     Token *peek(Token *t);
     Token *peekPastParen(Token *t);
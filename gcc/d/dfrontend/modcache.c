@@ -0,0 +1,404 @@
+/* Compiler implementation of the D programming language
+ * Copyright (c) 1999-2016 by Digital Mars
+ * All Rights Reserved
+ * http://www.digitalmars.com
+ * Distributed under the Boost Software License, Version 1.0.
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+
+/* Cache of lexed imported modules.
+ *
+ * A cache entry holds the token stream of one source file, and is named
+ * after the hash of the file's absolute path.  It starts with a header
+ * giving the compiler version, the path, and the length and hash of the
+ * source text it was made from; the entry is only used if all of these
+ * match.  The source is only hashed once its length is found to match.
+ * Identifiers are stored once in a table after the header, and tokens refer to them by index.  Each token also records its
+ * offset in the source, so Token::ptr of a replayed token points at the
+ * same text as it did when the source was scanned.
+ *
+ * Tokens are cached rather than parsed or analyzed modules: the AST has
+ * no serialized form, parsing a module allocates nodes that semantic
+ * then rewrites in place, and the outcome of semantic depends on the
+ * versions, debug levels and other flags of each compilation.  The
+ * source file itself is still read, as replayed tokens point into it.
+ *
+ * The token stream doesn't depend on the command line, except for
+ * __DATE__, __TIME__ and __TIMESTAMP__, and #line directives naming
+ * another file.  Modules using those are not cached, nor are modules
+ * that had lexer errors or deprecations, as replaying the tokens would
+ * lose the diagnostics.  Comments are not stored either, so the cache
+ * isn't used when generating documentation.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "rmem.h"
+#include "aav.h"
+
+#include "mars.h"
+#include "module.h"
+#include "lexer.h"
+#include "identifier.h"
+#include "modcache.h"
+
+#if _WIN32
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#endif
+#if POSIX
+#include <unistd.h>
+#endif
+
+static const char cacheMagic[8] = { 'D', 'T', 'O', 'K', 'C', 'A', 'C', '3' };
+
+/* FNV-1a hash, taking 8 bytes at a time.
+ */
+
+static d_uns64 hashBytes(const void *data, size_t len)
+{
+    const unsigned char *s = (const unsigned char *)data;
+    d_uns64 h = 14695981039346656037ULL;
+    for (; len >= 8; s += 8, len -= 8)
+    {
+        d_uns64 w;
+        memcpy(&w, s, sizeof(w));
+        h ^= w;
+        h *= 1099511628211ULL;
+    }
+    for (; len; s++, len--)
+    {
+        h ^= *s;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+
+/* Tokens whose ident field is set by the lexer.
+ */
+
+static bool hasIdent(TOK value)
+{
+    static bool init = false;
+    static bool table[TOKMAX];
+
+    if (!init)
+    {
+        for (size_t i = 0; i < TOKMAX; i++)
+        {
+            Token t;
+            t.value = (TOK)i;
+            table[i] = (i == TOKidentifier) || t.isKeyword();
+        }
+        init = true;
+    }
+    return table[value];
+}
+
+/* Make the name of the cache entry for source file name.
+ */
+
+static const char *cacheName(const char *name)
+{
+    static const char *cwd = NULL;
+
+    if (!FileName::absolute(name))
+    {
+        if (!cwd)
+            cwd = getcwd(NULL, 0);
+        if (cwd)
+            name = FileName::combine(cwd, name);
+    }
+
+    OutBuffer buf;
+    buf.printf("%016llx.tok", (unsigned long long)hashBytes(name, strlen(name)));
+    return FileName::combine(global.params.moduleCacheDir, buf.peekString());
+}
+
+TokenCache::TokenCache(Module *mod, const utf8_t *buf, size_t buflen)
+{
+    this->mod = mod;
+    this->cachename = cacheName(mod->srcfile->toChars());
+    this->base = buf;
+    this->srclen = buflen;
+    this->srchash = 0;
+    this->hashed = false;
+    this->numlines = 0;
+    this->replaying = false;
+    this->p = NULL;
+    this->cacheable = true;
+    this->identmap = NULL;
+}
+
+/********************************************
+ * Hash of the source text, computed when first needed.
+ */
+
+d_uns64 TokenCache::sourceHash()
+{
+    if (!hashed)
+    {
+        srchash = hashBytes(base, srclen);
+        hashed = true;
+    }
+    return srchash;
+}
+
+/********************************************
+ * Header of a cache entry.
+ */
+
+struct CacheHeader
+{
+    char magic[sizeof(cacheMagic)];
+    unsigned realsize;          // sizeof(real_t), as floats are stored raw
+    unsigned numlines;
+    d_uns64 srclen;
+    d_uns64 srchash;
+    d_uns64 tokenslen;          // length of the token stream
+    unsigned nidents;
+    unsigned versionlen;        // length of compiler version string
+    unsigned namelen;           // length of source file name
+    // followed by version string, source file name, identifiers, tokens
+};
+
+static bool readString(const utf8_t *&p, const utf8_t *end, const char *s, size_t len)
+{
+    if ((size_t)(end - p) < len || memcmp(p, s, len) != 0)
+        return false;
+    p += len;
+    return true;
+}
+
+static unsigned read4(const utf8_t *&p)
+{
+    unsigned v;
+    memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return v;
+}
+
+/********************************************
+ * Open the cache entry for reading.
+ * Returns:
+ *      true if the tokens will be read from the cache
+ */
+
+bool TokenCache::load()
+{
+    File *f = new File(cachename);
+    if (f->read())
+    {
+        delete f;
+        return false;
+    }
+
+    const utf8_t *start = (const utf8_t *)f->buffer;
+    const utf8_t *end = start + f->len;
+    const char *version = global.version;
+    const char *name = mod->srcfile->toChars();
+
+    CacheHeader h;
+    if (f->len < sizeof(h))
+        goto Lfail;
+    memcpy(&h, start, sizeof(h));
+    p = start + sizeof(h);
+
+    if (memcmp(h.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+        h.realsize != sizeof(real_t) ||
+        h.srclen != srclen ||
+        h.versionlen != strlen(version) ||
+        h.namelen != strlen(name) ||
+        !readString(p, end, version, h.versionlen) ||
+        !readString(p, end, name, h.namelen))
+        goto Lfail;
+
+    if (h.srchash != sourceHash())
+        goto Lfail;
+
+    idents.reserve(h.nidents);
+    for (size_t i = 0; i < h.nidents; i++)
+    {
+        if (end - p < 4)
+            goto Lfail;
+        size_t len = read4(p);
+        if ((size_t)(end - p) < len)
+            goto Lfail;
+        idents.push(Identifier::idPool((const char *)p, len));
+        p += len;
+    }
+    if ((size_t)(end - p) != h.tokenslen)
+        goto Lfail;
+
+    // Keep the buffer, string literals point into it
+    numlines = h.numlines;
+    replaying = true;
+    return true;
+
+Lfail:
+    idents.setDim(0);
+    p = NULL;
+    delete f;
+    return false;
+}
+
+/********************************************
+ * Read the next token from the cache entry.
+ */
+
+void TokenCache::read(Token *t)
+{
+    assert(replaying);
+    t->blockComment = NULL;
+    t->lineComment = NULL;
+    t->value = (TOK)*p++;
+    t->loc.filename = mod->srcfile->toChars();
+    t->loc.linnum = read4(p);
+    t->loc.charnum = read4(p);
+    t->ptr = base + read4(p);
+
+    switch (t->value)
+    {
+        case TOKint32v: case TOKuns32v:
+        case TOKint64v: case TOKuns64v:
+        case TOKint128v: case TOKuns128v:
+        case TOKcharv: case TOKwcharv: case TOKdcharv:
+            memcpy(&t->uns64value, p, sizeof(t->uns64value));
+            p += sizeof(t->uns64value);
+            break;
+
+        case TOKfloat32v: case TOKfloat64v: case TOKfloat80v:
+        case TOKimaginary32v: case TOKimaginary64v: case TOKimaginary80v:
+            memcpy(&t->floatvalue, p, sizeof(t->floatvalue));
+            p += sizeof(t->floatvalue);
+            break;
+
+        case TOKstring: case TOKxstring:
+            t->len = read4(p);
+            t->postfix = *p++;
+            t->ustring = (utf8_t *)p;
+            p += t->len + 1;
+            break;
+
+        default:
+            if (hasIdent(t->value))
+                t->ident = idents[read4(p)];
+            break;
+    }
+}
+
+/********************************************
+ * Append a token scanned by the lexer to the cache entry.
+ */
+
+void TokenCache::write(Token *t)
+{
+    if (!cacheable)
+        return;
+    if (t->loc.filename != mod->srcfile->toChars())
+    {
+        // #line directive naming another file
+        cacheable = false;
+        return;
+    }
+
+    tokens.writeByte(t->value);
+    tokens.write4(t->loc.linnum);
+    tokens.write4(t->loc.charnum);
+    tokens.write4((unsigned)(t->ptr - base));
+
+    switch (t->value)
+    {
+        case TOKint32v: case TOKuns32v:
+        case TOKint64v: case TOKuns64v:
+        case TOKint128v: case TOKuns128v:
+        case TOKcharv: case TOKwcharv: case TOKdcharv:
+            tokens.write(&t->uns64value, sizeof(t->uns64value));
+            break;
+
+        case TOKfloat32v: case TOKfloat64v: case TOKfloat80v:
+        case TOKimaginary32v: case TOKimaginary64v: case TOKimaginary80v:
+            tokens.write(&t->floatvalue, sizeof(t->floatvalue));
+            break;
+
+        case TOKstring: case TOKxstring:
+            tokens.write4(t->len);
+            tokens.writeByte(t->postfix);
+            tokens.write(t->ustring, t->len);
+            tokens.writeByte(0);
+            break;
+
+        default:
+            if (hasIdent(t->value))
+            {
+                size_t *pindex = (size_t *)dmd_aaGet(&identmap, t->ident);
+                if (!*pindex)
+                {
+                    idents.push(t->ident);
+                    *pindex = idents.dim;
+                }
+                tokens.write4((unsigned)(*pindex - 1));
+            }
+            break;
+    }
+}
+
+/********************************************
+ * Write the cache entry after the module has been parsed.
+ * The entry is written to a temporary file first and then renamed,
+ * so that compilers running in parallel never see a partial entry.
+ */
+
+void TokenCache::save(Lexer *lexer)
+{
+    if (replaying || !cacheable || lexer->errors)
+        return;
+
+    const char *version = global.version;
+    const char *name = mod->srcfile->toChars();
+
+    CacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, cacheMagic, sizeof(cacheMagic));
+    h.realsize = sizeof(real_t);
+    h.numlines = lexer->scanloc.linnum;
+    h.srclen = srclen;
+    h.srchash = sourceHash();
+    h.tokenslen = tokens.offset;
+    h.nidents = (unsigned)idents.dim;
+    h.versionlen = (unsigned)strlen(version);
+    h.namelen = (unsigned)strlen(name);
+
+    OutBuffer buf;
+    buf.reserve(sizeof(h) + tokens.offset + idents.dim * 16);
+    buf.write(&h, sizeof(h));
+    buf.write(version, h.versionlen);
+    buf.write(name, h.namelen);
+    for (size_t i = 0; i < idents.dim; i++)
+    {
+        const char *s = idents[i]->toChars();
+        size_t len = strlen(s);
+        buf.write4((unsigned)len);
+        buf.write(s, len);
+    }
+    buf.write(&tokens);
+
+    static bool pathChecked = false;
+    if (!pathChecked)
+    {
+        FileName::ensurePathExists(global.params.moduleCacheDir);
+        pathChecked = true;
+    }
+
+    OutBuffer tmpname;
+    tmpname.printf("%s.%d.tmp", cachename, (int)getpid());
+    File f(tmpname.peekString());
+    f.setbuffer(buf.data, buf.offset);
+    f.ref = 1;
+    if (f.write() || rename(f.toChars(), cachename) != 0)
+        f.remove();
+}
@@ -0,0 +1,61 @@
+/* Compiler implementation of the D programming language
+ * Copyright (c) 1999-2016 by Digital Mars
+ * All Rights Reserved
+ * http://www.digitalmars.com
+ * Distributed under the Boost Software License, Version 1.0.
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+
+#ifndef DMD_MODCACHE_H
+#define DMD_MODCACHE_H
+
+#ifdef __DMC__
+#pragma once
+#endif /* __DMC__ */
+
+#include "root.h"
+#include "arraytypes.h"
+
+class Module;
+class Identifier;
+class Lexer;
+struct Token;
+struct AA;
+
+/* Token stream of an imported module, kept in the -fmodule-cache=<dir>
+ * directory.  When the source text is the same as when the cache entry
+ * was written, the parser reads its tokens from the cache instead of
+ * lexing the source again.
+ */
+
+class TokenCache
+{
+public:
+    Module *mod;
+    const char *cachename;      // name of the cache entry
+    const utf8_t *base;         // source text
+    size_t srclen;              // length of the source text
+    d_uns64 srchash;            // hash of the source text, if hashed
+    bool hashed;
+    unsigned numlines;          // lines in the source text
+
+    // Reading from the cache entry
+    bool replaying;
+    const utf8_t *p;            // next token
+    Identifiers idents;
+
+    // Writing the cache entry
+    bool cacheable;             // false if tokens can't be replayed
+    OutBuffer tokens;
+    AA *identmap;               // Identifier => index + 1 in idents
+
+    TokenCache(Module *mod, const utf8_t *buf, size_t buflen);
+
+    d_uns64 sourceHash();
+    bool load();
+    void read(Token *t);
+    void write(Token *t);
+    void save(Lexer *lexer);
+};
+
+#endif /* DMD_MODCACHE_H */
@@ -25,6 +25,7 @@
 #include "lexer.h"
 #include "attrib.h"
 #include "target.h"
+#include "modcache.h"
 
 // For getcwd()
 #if _WIN32
@@ -32,6 +33,8 @@
 #endif
 #if POSIX
 #include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
 #endif
 
 AggregateDeclaration *Module::moduleinfo;
@@ -64,6 +67,9 @@ Module::Module(const char *filename, Identifier *ident, int doDocComment, int do
     numlines = 0;
     members = NULL;
     isDocFile = 0;
+    sourceParsed = false;
+    parseErrors = false;
+    cacheTokens = false;
     isPackageFile = false;
     needmoduleinfo = 0;
     selfimports = 0;
@@ -266,6 +272,8 @@ Module *Module::load(Loc loc, Identifiers *packages, Identifier *ident)
 
     Module *m = new Module(filename, ident, 0, 0);
     m->loc = loc;
+    // Comments are not cached, so don't use the cache when they are needed
+    m->cacheTokens = global.params.moduleCacheDir != NULL && !global.params.doDocComments;
 
     /* Look for the source file
      */
@@ -307,7 +315,7 @@ Module *Module::load(Loc loc, Identifiers *packages, Identifier *ident)
 bool Module::read(Loc loc)
 {
     //printf("Module::read('%s') file '%s'\n", toChars(), srcfile->toChars());
-    if (srcfile->read())
+    if (srcfile->mmread())
     {
         if (!strcmp(srcfile->toChars(), "object.d"))
         {
@@ -349,14 +357,34 @@ bool Module::read(Loc loc)
     return true;
 }
 
-Module *Module::parse()
+/************************************
+ * Returns true if parseSource() can be run on a parser thread.
+ * Source text in UTF-16 or UTF-32, and anything not starting with
+ * ASCII, goes through conversions that may be fatal, and has to be
+ * left to the main thread.
+ */
+
+bool Module::canParseInThread()
 {
-    //printf("Module::parse(srcfile='%s') this=%p\n", srcfile->name->toChars(), this);
+    utf8_t *buf = (utf8_t *)srcfile->buffer;
+    size_t buflen = srcfile->len;
 
-    const char *srcname = srcfile->name->toChars();
-    //printf("Module::parse(srcname = '%s')\n", srcname);
+    if (buflen < 2)
+        return true;
+    return buf[0] < 0x80 && buf[0] != 0 && buf[1] != 0;
+}
 
-    isPackageFile = (strcmp(srcfile->name->name(), "package.d") == 0);
+/************************************
+ * Convert the source text to UTF-8, and parse it into members.
+ * This only touches the module itself, the global identifier table,
+ * the allocator and, for float literals, GCC's real number support.
+ * The shared ones are locked, so it can be run for several modules at
+ * once.  Diagnostics must then be captured by the caller.
+ */
+
+void Module::parseSource()
+{
+    sourceParsed = true;
 
     utf8_t *buf = (utf8_t *)srcfile->buffer;
     size_t buflen = srcfile->len;
@@ -531,22 +559,48 @@ Module *Module::parse()
         isDocFile = 1;
         if (!docfile)
             setDocfile();
-        return this;
+        return;
     }
     {
         Parser p(this, buf, buflen, docfile != NULL);
+        TokenCache *tc = NULL;
+        if (cacheTokens)
+        {
+            tc = new TokenCache(this, buf, buflen);
+            tc->load();
+            p.tokcache = tc;
+        }
         p.nextToken();
         members = p.parseModule();
         md = p.md;
-        numlines = p.scanloc.linnum;
-        if (p.errors)
-            ++global.errors;
+        numlines = (tc && tc->replaying) ? tc->numlines : p.scanloc.linnum;
+        parseErrors = p.errors;
+        if (tc)
+        {
+            if (!parseErrors)
+                tc->save(&p);
+            delete tc;
+        }
     }
 
-    if (srcfile->ref == 0)
-        ::free(srcfile->buffer);
-    srcfile->buffer = NULL;
-    srcfile->len = 0;
+    srcfile->freeBuffer();
+}
+
+Module *Module::parse()
+{
+    //printf("Module::parse(srcfile='%s') this=%p\n", srcfile->name->toChars(), this);
+
+    const char *srcname = srcfile->name->toChars();
+    //printf("Module::parse(srcname = '%s')\n", srcname);
+
+    isPackageFile = (strcmp(srcfile->name->name(), "package.d") == 0);
+
+    if (!sourceParsed)
+        parseSource();
+    if (isDocFile)
+        return this;
+    if (parseErrors)
+        ++global.errors;
 
     /* The symbol table into which the module is to be inserted.
      */
@@ -1342,6 +1396,200 @@ Dsymbol *Package::search(Loc loc, Identifier *ident, int flags)
 
 /* ===========================  ===================== */
 
+/********************************************
+ * Cache of directory listings used when resolving imports.
+ * Each directory is read once, and the existence of files in it is
+ * then answered from memory instead of calling stat() for every
+ * candidate name along global.path.
+ */
+
+enum
+{
+    DIRENTnone,         // not in the directory
+    DIRENTfile,
+    DIRENTdir,
+    DIRENTunknown,      // type not given by readdir, stat() on demand
+    DIRENTfolded,       // only the lower case of a name in the directory
+};
+
+struct ImportStats
+{
+    unsigned lookups;   // existence queries
+    unsigned scans;     // directories read
+    unsigned stats;     // calls to stat()
+};
+
+static ImportStats importStats;
+static StringTable *dirCache;
+
+// Marker for directories that could not be read
+static StringTable unreadableDir;
+
+static int statFile(const char *name)
+{
+    importStats.stats++;
+    return FileName::exists(name);
+}
+
+static int cachedExists(const char *name);
+
+/* Lower case copy of the ASCII letters of name, or NULL if there are
+ * no upper case ones.
+ */
+
+static char *foldCase(const char *name, size_t len)
+{
+    size_t i = 0;
+    while (i < len && !(name[i] >= 'A' && name[i] <= 'Z'))
+        i++;
+    if (i == len)
+        return NULL;
+
+    char *folded = (char *)mem.xmalloc(len + 1);
+    for (i = 0; i < len; i++)
+    {
+        char c = name[i];
+        folded[i] = (c >= 'A' && c <= 'Z') ? c + 'a' - 'A' : c;
+    }
+    folded[len] = 0;
+    return folded;
+}
+
+/********************************************
+ * Get the listing of directory dir, reading it if not already cached.
+ * Returns:
+ *      NULL if dir does not exist, &unreadableDir if it could not be read.
+ */
+
+static StringTable *dirListing(const char *dir, size_t dirlen)
+{
+    if (!dirCache)
+    {
+        dirCache = new StringTable();
+        dirCache->_init();
+    }
+
+    StringValue *sv = dirCache->update(dir, dirlen);
+    if (sv->ptrvalue)
+        return (StringTable *)sv->ptrvalue;
+
+    const char *dirname = sv->toDchars();
+    StringTable *listing = NULL;
+#if POSIX
+    /* Ask the parent's listing first, so that a missing subdirectory
+     * doesn't cost a failed opendir().
+     */
+    const char *base = FileName::name(dirname);
+    if (base == dirname || (base == dirname + 1 && dirname[0] == '/') ||
+        strcmp(base, ".") == 0 || strcmp(base, "..") == 0 ||
+        cachedExists(dirname) == 2)
+    {
+        importStats.scans++;
+        DIR *d = opendir(dirname);
+        if (d)
+        {
+            listing = new StringTable();
+            listing->_init();
+            while (struct dirent *e = readdir(d))
+            {
+                size_t kind = DIRENTunknown;
+#if defined(DT_DIR)
+                if (e->d_type == DT_REG)
+                    kind = DIRENTfile;
+                else if (e->d_type == DT_DIR)
+                    kind = DIRENTdir;
+#endif
+                size_t len = strlen(e->d_name);
+                StringValue *sv = listing->update(e->d_name, len);
+                sv->ptrvalue = (void *)kind;
+
+                /* Also enter the name in lower case, so that names
+                 * differing only in case can be checked with stat() on
+                 * case insensitive file systems.
+                 */
+                char *folded = foldCase(e->d_name, len);
+                if (folded)
+                {
+                    StringValue *svf = listing->update(folded, len);
+                    if (!svf->ptrvalue)
+                        svf->ptrvalue = (void *)DIRENTfolded;
+                    mem.xfree(folded);
+                }
+            }
+            closedir(d);
+        }
+        else if (errno != ENOENT && errno != ENOTDIR)
+            listing = &unreadableDir;
+    }
+#else
+    listing = &unreadableDir;
+#endif
+    // Cache missing directories as an empty listing
+    if (!listing)
+    {
+        listing = new StringTable();
+        listing->_init(1);
+    }
+    sv->ptrvalue = listing;
+    return listing;
+}
+
+/********************************************
+ * Same as FileName::exists(), but answered from the directory cache.
+ * Returns:
+ *      0 if it doesn't exist, 1 if it's a file, 2 if it's a directory.
+ */
+
+static int cachedExists(const char *name)
+{
+    importStats.lookups++;
+
+    const char *base = FileName::name(name);
+    if (!*base)
+        return statFile(name);
+
+    size_t dirlen = base - name;
+    if (dirlen > 1)
+        dirlen--;               // strip the separator, but keep "/"
+    StringTable *listing = dirlen ? dirListing(name, dirlen) : dirListing(".", 1);
+    if (listing == &unreadableDir)
+        return statFile(name);
+
+    size_t baselen = strlen(base);
+    StringValue *sv = listing->lookup(base, baselen);
+    if (!sv || (size_t)sv->ptrvalue == DIRENTfolded)
+    {
+        /* The name is not in the directory as spelled, but it may be in
+         * another case, which the file system may or may not ignore.
+         */
+        char *folded = foldCase(base, baselen);
+        bool othercase = sv || (folded && listing->lookup(folded, baselen));
+        if (folded)
+            mem.xfree(folded);
+        return othercase ? statFile(name) : 0;
+    }
+
+    size_t kind = (size_t)sv->ptrvalue;
+    if (kind == DIRENTunknown)
+    {
+        // Symlinks and file systems without d_type
+        switch (statFile(name))
+        {
+            case 1:  kind = DIRENTfile;  break;
+            case 2:  kind = DIRENTdir;   break;
+            default: kind = DIRENTnone;  break;
+        }
+        sv->ptrvalue = (void *)kind;
+    }
+    return kind == DIRENTfile ? 1 : kind == DIRENTdir ? 2 : 0;
+}
+
+void Module::printStats()
+{
+    fprintf(global.stdmsg, "imports   %u lookups, %u directory scans, %u stats\n",
+            importStats.lookups, importStats.scans, importStats.stats);
+}
+
 /********************************************
  * Look for the source file if it's different from filename.
  * Look for .di, .d, directory, and along global.path.
@@ -1362,21 +1610,21 @@ const char *lookForSourceFile(const char **path, const char *filename)
     *path = NULL;
 
     const char *sdi = FileName::forceExt(filename, global.hdr_ext);
-    if (FileName::exists(sdi) == 1)
+    if (cachedExists(sdi) == 1)
         return sdi;
 
     const char *sd  = FileName::forceExt(filename, global.mars_ext);
-    if (FileName::exists(sd) == 1)
+    if (cachedExists(sd) == 1)
         return sd;
 
-    if (FileName::exists(filename) == 2)
+    if (cachedExists(filename) == 2)
     {
         /* The filename exists and it's a directory.
          * Therefore, the result should be: filename/package.d
          * iff filename/package.d is a file
          */
         const char *n = FileName::combine(filename, "package.d");
-        if (FileName::exists(n) == 1)
+        if (cachedExists(n) == 1)
             return n;
         FileName::free(n);
     }
@@ -1392,7 +1640,7 @@ const char *lookForSourceFile(const char **path, const char *filename)
         const char *p = (*global.path)[i];
 
         const char *n = FileName::combine(p, sdi);
-        if (FileName::exists(n) == 1)
+        if (cachedExists(n) == 1)
         {
             *path = p;
             return n;
@@ -1400,7 +1648,7 @@ const char *lookForSourceFile(const char **path, const char *filename)
         FileName::free(n);
 
         n = FileName::combine(p, sd);
-        if (FileName::exists(n) == 1)
+        if (cachedExists(n) == 1)
         {
             *path = p;
             return n;
@@ -1410,10 +1658,10 @@ const char *lookForSourceFile(const char **path, const char *filename)
         const char *b = FileName::removeExt(filename);
         n = FileName::combine(p, b);
         FileName::free(b);
-        if (FileName::exists(n) == 2)
+        if (cachedExists(n) == 2)
         {
             const char *n2 = FileName::combine(n, "package.d");
-            if (FileName::exists(n2) == 1)
+            if (cachedExists(n2) == 1)
             {
                 *path = p;
                 return n2;
@@ -81,6 +81,9 @@ public:
     unsigned errors;    // if any errors in file
     unsigned numlines;  // number of lines in source file
     int isDocFile;      // if it is a documentation input file, not D source
+    bool sourceParsed;  // if parseSource() has been run
+    bool parseErrors;   // if parseSource() found errors
+    bool cacheTokens;   // if parseSource() uses the module cache
     bool isPackageFile; // if it is a package.d
     int needmoduleinfo;
 
@@ -127,6 +130,8 @@ public:
     File *setOutfile(const char *name, const char *dir, const char *arg, const char *ext);
     void setDocfile();
     bool read(Loc loc); // read file, returns 'true' if succeed, 'false' otherwise.
+    bool canParseInThread();
+    void parseSource(); // lex and parse the source text
     Module *parse();    // syntactic parse
     void importAll(Scope *sc);
     void semantic(Scope *);    // semantic analysis
@@ -144,6 +149,7 @@ public:
     static void runDeferredSemantic2();
     static void runDeferredSemantic3();
     static void clearCache();
+    static void printStats();
     int imports(Module *m);
 
     bool isRoot() { return this->importedFrom == this; }
@@ -2131,7 +2131,9 @@ Expression *Type::getProperty(Loc loc, Identifier *ident, int flag)
             s = s->search_correct(ident);
         if (this != Type::terror)
         {
-            if (s)
+            if (global.diagnosticsGagged())
+                global.increaseErrorCount();
+            else if (s)
                 error(loc, "no property '%s' for type '%s', did you mean '%s'?", ident->toChars(), toChars(), s->toChars());
             else
                 error(loc, "no property '%s' for type '%s'", ident->toChars(), toChars());
@@ -80,6 +80,8 @@ public:
     {
         if (e->type->ty != Tarray || !e->elements || !e->elements->dim)
             return;
+        if (e->onstack)
+            return;
 
         if (f->setGC())
         {
@@ -27,6 +27,34 @@ typedef unsigned long long ulonglong;
 
 typedef unsigned char utf8_t;
 
+// Storage class for variables with one instance per thread.
+#if _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// Lock for the few global tables shared by parser threads.
+// Statically zero initialized, so it can be used before any constructor runs.
+struct SpinLock
+{
+    volatile int locked;
+
+    void lock()
+    {
+        while (__sync_lock_test_and_set(&locked, 1))
+        {
+            while (__atomic_load_n(&locked, __ATOMIC_RELAXED))
+                ;
+        }
+    }
+
+    void unlock()
+    {
+        __sync_lock_release(&locked);
+    }
+};
+
 struct Port
 {
     static int memicmp(const char *s1, const char *s2, int n);
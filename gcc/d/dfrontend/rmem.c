@@ -12,6 +12,7 @@
 #include <string.h>
 
 #include "rmem.h"
+#include "port.h"
 
 /* This implementation of the storage allocator uses the standard C allocation package.
  */
@@ -124,40 +125,146 @@ void Mem::error()
 // causes the actual memory block to be larger than 1Mb otherwise.
 #define CHUNK_SIZE (256 * 4096 - 64)
 
-static size_t heapleft = 0;
-static void *heapp;
+// In arena mode, each new chunk is twice the size of the last, up to this limit.
+#define ARENA_MAX_CHUNK_SIZE (64 * 1024 * 1024 - 64)
+
+// Size classes are 16 byte steps up to 256 bytes, then powers of 2.
+#define NUM_SIZE_CLASSES 24
+
+bool Mem::arena = false;
+
+struct Heap
+{
+    size_t heapleft;
+    void *heapp;
+    size_t chunksize;           // 0 until the first chunk is allocated
+    size_t numchunks;
+    size_t chunkbytes;
+    size_t unusedbytes;
+    size_t classcount[NUM_SIZE_CLASSES];
+    size_t classbytes[NUM_SIZE_CLASSES];
+};
+
+// Each thread allocates from its own chunks, so no locking is needed.
+static THREAD_LOCAL Heap heap;
+
+// Statistics of threads that have finished.
+static Heap totals;
+static SpinLock totalsLock;
+
+static unsigned sizeClass(size_t m_size)
+{
+    if (m_size <= 256)
+        return m_size ? (unsigned)(m_size / 16 - 1) : 0;
+
+    unsigned c = 16;
+    for (size_t limit = 512; m_size > limit && c < NUM_SIZE_CLASSES - 1; limit <<= 1)
+        c++;
+    return c;
+}
+
+static void *arenaChunk(size_t m_size)
+{
+    void *p = malloc(m_size);
+    if (!p)
+    {
+        printf("Error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
 
 extern "C" void *allocmemory(size_t m_size)
 {
     // 16 byte alignment is better (and sometimes needed) for doubles
     m_size = (m_size + 15) & ~15;
 
+    if (Mem::arena)
+    {
+        unsigned c = sizeClass(m_size);
+        heap.classcount[c]++;
+        heap.classbytes[c] += m_size;
+    }
+
     // The layout of the code is selected so the most common case is straight through
-    if (m_size <= heapleft)
+    if (m_size <= heap.heapleft)
     {
      L1:
-        heapleft -= m_size;
-        void *p = heapp;
-        heapp = (void *)((char *)heapp + m_size);
+        heap.heapleft -= m_size;
+        void *p = heap.heapp;
+        heap.heapp = (void *)((char *)heap.heapp + m_size);
         return p;
     }
 
     if (m_size > CHUNK_SIZE)
+        return arenaChunk(m_size);
+
+    if (!heap.chunksize)
+        heap.chunksize = CHUNK_SIZE;
+    if (Mem::arena)
     {
-        void *p = malloc(m_size);
-        if (p)
-            return p;
-        printf("Error: out of memory\n");
-        exit(EXIT_FAILURE);
-        return p;
+        // Don't throw away the rest of the current chunk for a big
+        // allocation, small ones will still fit there.
+        if (m_size > heap.chunksize / 16)
+            return arenaChunk(m_size);
+
+        heap.unusedbytes += heap.heapleft;
+        if (heap.numchunks && heap.chunksize < ARENA_MAX_CHUNK_SIZE)
+            heap.chunksize = heap.chunksize * 2 + 64;
+        heap.numchunks++;
+        heap.chunkbytes += heap.chunksize;
     }
 
-    heapleft = CHUNK_SIZE;
-    heapp = malloc(CHUNK_SIZE);
-    if (!heapp)
+    heap.heapleft = heap.chunksize;
+    heap.heapp = arenaChunk(heap.chunksize);
+    goto L1;
+}
+
+/* Called by threads other than the main thread before they exit.
+ * The rest of their current chunk is abandoned.
+ */
+void Mem::threadDone()
+{
+    totalsLock.lock();
+    totals.numchunks += heap.numchunks;
+    totals.chunkbytes += heap.chunkbytes;
+    totals.unusedbytes += heap.unusedbytes + heap.heapleft;
+    for (unsigned c = 0; c < NUM_SIZE_CLASSES; c++)
     {
-        printf("Error: out of memory\n");
-        exit(EXIT_FAILURE);
+        totals.classcount[c] += heap.classcount[c];
+        totals.classbytes[c] += heap.classbytes[c];
+    }
+    totalsLock.unlock();
+    memset(&heap, 0, sizeof(heap));
+}
+
+/* Print statistics about memory allocated by allocmemory.
+ */
+
+void Mem::printStats(FILE *fp)
+{
+    if (!arena)
+        return;
+
+    fprintf(fp, "arena     %llu chunks, %llu bytes reserved, %llu bytes unused\n",
+            (unsigned long long)(heap.numchunks + totals.numchunks),
+            (unsigned long long)(heap.chunkbytes + totals.chunkbytes),
+            (unsigned long long)(heap.unusedbytes + heap.heapleft + totals.unusedbytes));
+
+    for (unsigned c = 0; c < NUM_SIZE_CLASSES; c++)
+    {
+        size_t count = heap.classcount[c] + totals.classcount[c];
+        size_t bytes = heap.classbytes[c] + totals.classbytes[c];
+        if (!count)
+            continue;
+
+        if (c < 16)
+            fprintf(fp, "arena     %8u bytes", (c + 1) * 16);
+        else if (c < NUM_SIZE_CLASSES - 1)
+            fprintf(fp, "arena     %8u bytes", 256u << (c - 15));
+        else
+            fprintf(fp, "arena        large");
+        fprintf(fp, " %10llu allocs %12llu total\n",
+                (unsigned long long)count, (unsigned long long)bytes);
     }
-    goto L1;
 }
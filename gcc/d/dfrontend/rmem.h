@@ -11,6 +11,7 @@
 #define ROOT_MEM_H
 
 #include <stddef.h>     // for size_t
+#include <stdio.h>      // for FILE
 
 #if __APPLE__ && __i386__
     /* size_t is 'unsigned long', which makes it mangle differently
@@ -32,6 +33,11 @@ struct Mem
     static void xfree(void *p);
     static void *xmallocdup(void *o, d_size_t size);
     static void error();
+
+    // Allocator for operator new, memory is never released.
+    static bool arena;          // use growing chunks and keep statistics
+    static void printStats(FILE *fp);
+    static void threadDone();   // fold statistics of exiting thread into totals
 };
 
 extern Mem mem;
@@ -35,6 +35,7 @@
 #include "id.h"
 #include "attrib.h"
 #include "tokens.h"
+#include "timetrace.h"
 
 #define LOG     0
 
@@ -371,39 +372,119 @@ int arrayObjectMatch(Objects *oa1, Objects *oa2)
 
 
 /************************************
- * Return hash of Objects.
+ * Helpers for building a 64-bit fingerprint of template arguments.
  */
-hash_t arrayObjectHash(Objects *oa1)
+static inline uint64_t hashCombine(uint64_t hash, uint64_t v)
 {
-    hash_t hash = 0;
+    hash = (hash ^ v) * 0x9e3779b97f4a7c15ULL;
+    return hash ^ (hash >> 29);
+}
+
+static uint64_t hashBytes(uint64_t hash, const void *p, size_t len)
+{
+    const unsigned char *s = (const unsigned char *)p;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ s[i]) * 0x100000001b3ULL;
+    return hashCombine(hash, h ^ len);
+}
+
+static uint64_t typeHash(uint64_t hash, Type *t)
+{
+    // Merged types with the same deco compare equal.
+    if (t && t->deco)
+        return hashBytes(hash, t->deco, strlen(t->deco));
+    return hashCombine(hash, (size_t)t);
+}
+
+/************************************
+ * Return fingerprint of the value of an expression.
+ * Must be consistent with the equals() overrides, so that
+ * expressions that match always have the same fingerprint.
+ */
+static uint64_t expressionHash(uint64_t hash, Expression *e)
+{
+    if (!e)
+        return hashCombine(hash, 0);
+
+    hash = hashCombine(hash, e->op);
+    switch (e->op)
+    {
+        case TOKint64:
+            return hashCombine(hash, ((IntegerExp *)e)->getInteger());
+
+        case TOKnull:
+            return typeHash(hash, e->type);
+
+        case TOKstring:
+        {
+            StringExp *se = (StringExp *)e;
+            return hashBytes(hash, se->string, se->len * se->sz);
+        }
+
+        case TOKarrayliteral:
+        {
+            ArrayLiteralExp *ae = (ArrayLiteralExp *)e;
+            hash = hashCombine(hash, ae->elements->dim);
+            for (size_t i = 0; i < ae->elements->dim; i++)
+            {
+                Expression *el = (*ae->elements)[i];
+                hash = expressionHash(hash, el ? el : ae->basis);
+            }
+            return hash;
+        }
+
+        case TOKstructliteral:
+        {
+            StructLiteralExp *se = (StructLiteralExp *)e;
+            hash = typeHash(hash, se->type);
+            for (size_t i = 0; i < se->elements->dim; i++)
+                hash = expressionHash(hash, (*se->elements)[i]);
+            return hash;
+        }
+
+        case TOKvar:
+            return hashCombine(hash, (size_t)((VarExp *)e)->var);
+
+        default:
+            // Floating point values may compare equal with different
+            // representations, so only the kind of expression is used.
+            return hash;
+    }
+}
+
+/************************************
+ * Return 64-bit structural fingerprint of Objects.
+ * Argument order is significant.
+ */
+uint64_t arrayObjectHash(Objects *oa1)
+{
+    uint64_t hash = hashCombine(0, oa1->dim);
     for (size_t j = 0; j < oa1->dim; j++)
     {
         /* Must follow the logic of match()
          */
         RootObject *o1 = (*oa1)[j];
         if (Type *t1 = isType(o1))
-            hash += (size_t)t1->deco;
+            hash = typeHash(hashCombine(hash, DYNCAST_TYPE), t1);
         else
         {
             Dsymbol *s1 = isDsymbol(o1);
             Expression *e1 = s1 ? getValue(s1) : getValue(isExpression(o1));
             if (e1)
-            {
-                if (e1->op == TOKint64)
-                {
-                    IntegerExp *ne = (IntegerExp *)e1;
-                    hash += (size_t)ne->getInteger();
-                }
-            }
+                hash = expressionHash(hashCombine(hash, DYNCAST_EXPRESSION), e1);
             else if (s1)
             {
                 FuncAliasDeclaration *fa1 = s1->isFuncAliasDeclaration();
                 if (fa1)
                     s1 = fa1->toAliasFunc();
-                hash += (size_t)(void *)s1->getIdent() + (size_t)(void *)s1->parent;
+                hash = hashCombine(hash, DYNCAST_DSYMBOL);
+                hash = hashCombine(hash, (size_t)(void *)s1->getIdent() + (size_t)(void *)s1->parent);
             }
             else if (Tuple *u1 = isTuple(o1))
-                hash += arrayObjectHash(&u1->objects);
+                hash = hashCombine(hashCombine(hash, DYNCAST_TUPLE), arrayObjectHash(&u1->objects));
+            else
+                hash = hashCombine(hash, DYNCAST_OBJECT);
         }
     }
     return hash;
@@ -2811,6 +2892,15 @@ Prot TemplateDeclaration::prot()
     return protection;
 }
 
+/* Counters for the instances hash tables of all TemplateDeclarations.
+ */
+static struct
+{
+    uint64_t lookups;           // calls to findExistingInstance()
+    uint64_t hits;              // existing instance was found
+    uint64_t collisions;        // compare() failed on same fingerprint
+} instanceStats;
+
 /****************************************************
  * Given a new instance tithis of this TemplateDeclaration,
  * see if there already exists an instance.
@@ -2821,6 +2911,7 @@ TemplateInstance *TemplateDeclaration::findExistingInstance(TemplateInstance *ti
 {
     //printf("findExistingInstance(%p)\n", tithis);
     tithis->fargs = fargs;
+    instanceStats.lookups++;
     TemplateInstances *tinstances = (TemplateInstances *)dmd_aaGetRvalue((AA *)instances, (void *)tithis->toHash());
     if (tinstances)
     {
@@ -2828,12 +2919,28 @@ TemplateInstance *TemplateDeclaration::findExistingInstance(TemplateInstance *ti
         {
             TemplateInstance *ti = (*tinstances)[i];
             if (tithis->compare(ti) == 0)
+            {
+                instanceStats.hits++;
                 return ti;
+            }
+            instanceStats.collisions++;
         }
     }
     return NULL;
 }
 
+/********************************************
+ * Print statistics about TemplateInstance lookups.
+ */
+
+void TemplateDeclaration::printStats()
+{
+    fprintf(global.stdmsg, "templates %llu lookups, %llu hits, %llu collisions\n",
+            (unsigned long long)instanceStats.lookups,
+            (unsigned long long)instanceStats.hits,
+            (unsigned long long)instanceStats.collisions);
+}
+
 /********************************************
  * Add instance ti to TemplateDeclaration's table of instances.
  * Return a handle we can use to later remove it if it fails instantiation.
@@ -5870,6 +5977,8 @@ void TemplateInstance::semantic(Scope *sc, Expressions *fargs)
         return;
     }
 
+    TimeTraceScope trace("Instantiate template", this);
+
     // Get the enclosing template instance from the scope tinst
     tinst = sc->tinst;
 
@@ -7035,6 +7144,8 @@ bool TemplateInstance::findBestMatch(Scope *sc, Expressions *fargs)
 
         if (errs != global.errors)
             errorSupplemental(loc, "while looking for match for %s", toChars());
+        else if (global.diagnosticsGagged())
+            global.increaseErrorCount();
         else if (tdecl && !tdecl->overnext)
         {
             // Only one template, so we can give better error message
@@ -7911,8 +8022,8 @@ hash_t TemplateInstance::toHash()
 {
     if (!hash)
     {
-        hash = (size_t)(void *)enclosing;
-        hash += arrayObjectHash(&tdtypes);
+        uint64_t h = hashCombine(arrayObjectHash(&tdtypes), (size_t)(void *)enclosing);
+        hash = (hash_t)h;
         hash += hash == 0;
     }
     return hash;
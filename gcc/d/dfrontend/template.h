@@ -105,6 +105,7 @@ public:
     TemplateInstance *findExistingInstance(TemplateInstance *tithis, Expressions *fargs);
     TemplateInstance *addInstance(TemplateInstance *ti);
     void removeInstance(TemplateInstance *handle);
+    static void printStats();
 
     TemplateDeclaration *isTemplateDeclaration() { return this; }
 
@@ -0,0 +1,219 @@
+/* Compiler implementation of the D programming language
+ * Copyright (c) 1999-2016 by Digital Mars
+ * All Rights Reserved
+ * http://www.digitalmars.com
+ * Distributed under the Boost Software License, Version 1.0.
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+
+/* Time trace for -ftime-trace.
+ *
+ * Each TimeTraceScope becomes a complete ("X") event, giving its start and
+ * duration in microseconds; nesting is shown by the viewer from the times.
+ * Events shorter than -ftime-trace-granularity are left out to keep the
+ * file small, but still count towards the "Total" event written for each
+ * event name, so the totals account for all of the time spent.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "root.h"
+#include "rmem.h"
+
+#include "mars.h"
+#include "dsymbol.h"
+#include "timetrace.h"
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+struct TimeTraceFrame
+{
+    const char *name;
+    d_uns64 start;              // microseconds since the trace began
+};
+
+struct TimeTraceEvent
+{
+    const char *name;
+    const char *detail;
+    d_uns64 start;
+    d_uns64 duration;
+};
+
+struct TimeTraceTotal
+{
+    const char *name;
+    d_uns64 duration;
+    unsigned count;
+};
+
+static d_uns64 traceBegin;      // absolute time the trace began
+static Array<TimeTraceFrame> traceStack;
+static Array<TimeTraceEvent> traceEvents;
+static Array<TimeTraceTotal> traceTotals;
+
+/* Wall clock time in microseconds.
+ */
+
+static d_uns64 timeNow()
+{
+#if _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (count.QuadPart / freq.QuadPart) * 1000000
+        + (count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (d_uns64)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+void timeTraceBeginEvent(const char *name)
+{
+    if (!traceBegin)
+        traceBegin = timeNow();
+
+    TimeTraceFrame frame;
+    frame.name = name;
+    frame.start = timeNow() - traceBegin;
+    traceStack.push(frame);
+}
+
+void timeTraceEndEvent(Dsymbol *detail)
+{
+    assert(traceStack.dim);
+    TimeTraceFrame frame = traceStack.pop();
+    d_uns64 duration = timeNow() - traceBegin - frame.start;
+
+    /* Time spent in an event nested in another of the same name, such as
+     * a template instantiated while instantiating another, is already
+     * part of the outer event's total.
+     */
+    bool nested = false;
+    for (size_t i = 0; i < traceStack.dim; i++)
+    {
+        if (strcmp(traceStack[i].name, frame.name) == 0)
+        {
+            nested = true;
+            break;
+        }
+    }
+
+    if (!nested)
+    {
+        size_t i = 0;
+        for (; i < traceTotals.dim; i++)
+        {
+            if (strcmp(traceTotals[i].name, frame.name) == 0)
+                break;
+        }
+        if (i == traceTotals.dim)
+        {
+            TimeTraceTotal total;
+            total.name = frame.name;
+            total.duration = 0;
+            total.count = 0;
+            traceTotals.push(total);
+        }
+        traceTotals[i].duration += duration;
+        traceTotals[i].count++;
+    }
+
+    if (duration < global.params.timeTraceGranularity)
+        return;
+
+    TimeTraceEvent e;
+    e.name = frame.name;
+    e.detail = detail ? detail->toPrettyChars() : NULL;
+    e.start = frame.start;
+    e.duration = duration;
+    traceEvents.push(e);
+}
+
+/* Write s to buf as a JSON string.
+ */
+
+static void writeJsonString(OutBuffer *buf, const char *s)
+{
+    buf->writeByte('"');
+    for (; *s; s++)
+    {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+        {
+            buf->writeByte('\\');
+            buf->writeByte(c);
+        }
+        else if (c < ' ')
+            buf->printf("\\u%04x", c);
+        else
+            buf->writeByte(c);
+    }
+    buf->writeByte('"');
+}
+
+static int totalCmp(const void *p1, const void *p2)
+{
+    const TimeTraceTotal *t1 = (const TimeTraceTotal *)p1;
+    const TimeTraceTotal *t2 = (const TimeTraceTotal *)p2;
+    if (t1->duration != t2->duration)
+        return t1->duration > t2->duration ? -1 : 1;
+    return strcmp(t1->name, t2->name);
+}
+
+void timeTraceWrite(const char *filename)
+{
+    // Events still open were cut short by errors; there is nothing to end.
+    traceStack.setDim(0);
+
+    OutBuffer buf;
+    buf.writestring("{\"traceEvents\":[\n");
+    buf.writestring("{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"process_name\",\"args\":{\"name\":");
+    writeJsonString(&buf, FileName::name(global.params.argv0));
+    buf.writestring("}}");
+
+    for (size_t i = 0; i < traceEvents.dim; i++)
+    {
+        TimeTraceEvent *e = &traceEvents[i];
+        buf.printf(",\n{\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%llu,\"dur\":%llu,\"name\":",
+            (unsigned long long)e->start, (unsigned long long)e->duration);
+        writeJsonString(&buf, e->name);
+        if (e->detail)
+        {
+            buf.writestring(",\"args\":{\"detail\":");
+            writeJsonString(&buf, e->detail);
+            buf.writeByte('}');
+        }
+        buf.writeByte('}');
+    }
+
+    /* The totals go on a thread of their own each, largest first, so
+     * they are listed below the timeline.
+     */
+    qsort(traceTotals.data, traceTotals.dim, sizeof(TimeTraceTotal), &totalCmp);
+    for (size_t i = 0; i < traceTotals.dim; i++)
+    {
+        TimeTraceTotal *t = &traceTotals[i];
+        buf.printf(",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":0,\"dur\":%llu,\"name\":\"Total %s\",",
+            (int)i + 1, (unsigned long long)t->duration, t->name);
+        buf.printf("\"args\":{\"count\":%u,\"avg ms\":%.3f}}",
+            t->count, (double)t->duration / t->count / 1000);
+    }
+
+    buf.printf("\n],\n\"beginningOfTime\":%llu\n}\n", (unsigned long long)traceBegin);
+
+    File f(filename);
+    f.setbuffer(buf.data, buf.offset);
+    f.ref = 1;
+    writeFile(Loc(), &f);
+}
@@ -0,0 +1,52 @@
+/* Compiler implementation of the D programming language
+ * Copyright (c) 1999-2016 by Digital Mars
+ * All Rights Reserved
+ * http://www.digitalmars.com
+ * Distributed under the Boost Software License, Version 1.0.
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+
+#ifndef DMD_TIMETRACE_H
+#define DMD_TIMETRACE_H
+
+#ifdef __DMC__
+#pragma once
+#endif /* __DMC__ */
+
+#include "globals.h"
+
+class Dsymbol;
+
+/* Profile of where compile time goes, written for -ftime-trace in the
+ * Chrome trace event format, so it can be loaded in chrome://tracing or
+ * https://ui.perfetto.dev.
+ */
+
+void timeTraceBeginEvent(const char *name);
+void timeTraceEndEvent(Dsymbol *detail);
+void timeTraceWrite(const char *filename);
+
+/* Records the time spent until the end of the enclosing block as an
+ * event called NAME.  If the event is kept, DETAIL is named in it; it
+ * is only pretty printed then.
+ */
+
+struct TimeTraceScope
+{
+    Dsymbol *detail;
+
+    TimeTraceScope(const char *name, Dsymbol *detail = NULL)
+        : detail(detail)
+    {
+        if (global.params.timeTrace)
+            timeTraceBeginEvent(name);
+    }
+
+    ~TimeTraceScope()
+    {
+        if (global.params.timeTrace)
+            timeTraceEndEvent(detail);
+    }
+};
+
+#endif /* DMD_TIMETRACE_H */
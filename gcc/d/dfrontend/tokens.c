@@ -21,7 +21,7 @@
 
 /************************* Token **********************************************/
 
-Token *Token::freelist = NULL;
+THREAD_LOCAL Token *Token::freelist = NULL;
 
 const char *Token::tochars[TOKMAX];
 
@@ -53,7 +53,7 @@ void Token::print()
 
 const char *Token::toChars() const
 {
-    static char buffer[3 + 3 * sizeof(floatvalue) + 1];
+    static THREAD_LOCAL char buffer[3 + 3 * sizeof(floatvalue) + 1];
 
     const char *p = &buffer[0];
     switch (value)
@@ -191,7 +191,7 @@ const char *Token::toChars() const
 
 const char *Token::toChars(TOK value)
 {
-    static char buffer[3 + 3 * sizeof(value) + 1];
+    static THREAD_LOCAL char buffer[3 + 3 * sizeof(value) + 1];
 
     const char *p = tochars[value];
     if (!p)
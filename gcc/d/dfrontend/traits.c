@@ -1260,7 +1260,11 @@ Expression *semanticTraits(TraitsExp *e, Scope *sc)
     }
     else
     {
-        if (const char *sub = (const char *)speller(e->ident->toChars(), &trait_search_fp, NULL, idchars))
+        // Don't spell check when gagged, the suggestion would be discarded.
+        const char *sub = NULL;
+        if (!global.diagnosticsGagged())
+            sub = (const char *)speller(e->ident->toChars(), &trait_search_fp, NULL, idchars);
+        if (sub)
             e->error("unrecognized trait '%s', did you mean '%s'?", e->ident->toChars(), sub);
         else
             e->error("unrecognized trait '%s'", e->ident->toChars());
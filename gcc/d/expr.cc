@@ -91,6 +91,73 @@ class ExprVisitor : public Visitor
 	    || (e->op == TOKcast && ((UnaExp *) e)->e1->isLvalue()));
   }
 
+  // Determine if values of type T can be allocated on the GC heap without
+  // passing their TypeInfo to the runtime.  The TypeInfo is only needed to
+  // finalize structs with a destructor, or to copy the initializer of
+  // static arrays of non-zero initialized elements.
+  bool new_without_typeinfo_p(Type *t)
+  {
+    if (this->needs_dtor(t))
+      return false;
+
+    t = t->toBasetype();
+    return t->ty != Tsarray || t->isZeroInit();
+  }
+
+  // Return the GC block attributes for memory holding values of type T.
+  // This follows the flags of the TypeInfo for T, which treat void, and
+  // static arrays of void, as possibly holding pointers.
+  tree gc_block_attributes(Type *t)
+  {
+    Type *tb = t->toBasetype();
+    while (tb->ty == Tsarray)
+      tb = tb->nextOf()->toBasetype();
+
+    // BlkAttr.NO_SCAN, if there are no pointers in T to scan.
+    bool scan = tb->ty == Tvoid || t->hasPointers();
+    return build_int_cst(uint_type_node, scan ? 0 : 2);
+  }
+
+  // Return the default initializer of T, to be copied into memory newly
+  // allocated for it.  For structs this is the static initializer symbol,
+  // so that any padding is copied as well.
+  tree build_new_init(Type *t, const Loc& loc)
+  {
+    Type *tb = t->toBasetype();
+
+    if (tb->ty == Tstruct)
+      return aggregate_initializer_decl (((TypeStruct *) tb)->sym);
+
+    return build_expr(t->defaultInitLiteral(loc));
+  }
+
+  // Build a call to allocate a single item of type T on the GC heap,
+  // returning a pointer to it, default initialized.
+  tree build_new_item(Type *t, const Loc& loc)
+  {
+    tree ptrtype = build_ctype(t->pointerTo());
+
+    if (!this->new_without_typeinfo_p(t))
+      {
+	LibCall libcall = t->isZeroInit(loc)
+	  ? LIBCALL_NEWITEMT : LIBCALL_NEWITEMIT;
+	tree arg = build_typeinfo(t);
+	return build_libcall(libcall, 1, &arg, ptrtype);
+      }
+
+    tree args[2];
+    args[0] = size_int(t->size());
+    args[1] = this->gc_block_attributes(t);
+
+    if (t->isZeroInit(loc))
+      return build_libcall(LIBCALL_NEWITEMN, 2, args, ptrtype);
+
+    tree result = d_save_expr(build_libcall(LIBCALL_NEWITEMNU, 2, args,
+					    ptrtype));
+    tree init = modify_expr(build_deref(result), this->build_new_init(t, loc));
+    return compound_expr(init, result);
+  }
+
 public:
   ExprVisitor(bool constp)
   {
@@ -331,13 +398,35 @@ public:
 
     Type *tkey = ((TypeAArray *) tb2)->index->toBasetype();
     tree key = convert_expr(build_expr(e->e1), e->e1->type, tkey);
-    tree args[3];
+    tree result;
+
+    // Hash the key inline if the compiler knows how.
+    LibCall equals;
+    key = d_save_expr(key);
+    tree hash = build_aa_key_hash(tkey, key, &equals);
+
+    if (hash != NULL_TREE)
+      {
+	tree args[4];
+
+	args[0] = build_expr(e->e2);
+	args[1] = build_address(key);
+	args[2] = hash;
+	args[3] = build_address(get_symbol_decl(get_libcall(equals)));
+
+	result = build_libcall(LIBCALL_AAINXH, 4, args);
+      }
+    else
+      {
+	tree args[3];
+
+	args[0] = build_expr(e->e2);
+	args[1] = build_typeinfo(tkey);
+	args[2] = build_address(key);
 
-    args[0] = build_expr(e->e2);
-    args[1] = build_typeinfo(tkey);
-    args[2] = build_address(key);
+	result = build_libcall(LIBCALL_AAINX, 3, args);
+      }
 
-    tree result = build_libcall(LIBCALL_AAINX, 3, args);
     this->result_ = convert(build_ctype(e->type), result);
   }
 
@@ -414,12 +503,33 @@ public:
 	&& (tb2->ty == Tsarray || tb2->ty == Tarray))
       {
 	Type *telem = tb1->nextOf()->toBasetype();
-	tree args[3];
+	tree t1 = d_array_convert(e->e1);
+	tree t2 = d_array_convert(e->e2);
 
-	args[0] = d_array_convert(e->e1);
-	args[1] = d_array_convert(e->e2);
-	args[2] = build_typeinfo(telem->arrayOf());
-	result = build_libcall(LIBCALL_ADCMP2, 3, args);
+	// Compare arrays of scalars inline, otherwise _adCmp2 compares
+	// each element using the TypeInfo.
+	tree t1saved = d_save_expr(t1);
+	tree t2saved = d_save_expr(t2);
+	result = build_array_compare(telem, t1saved, t2saved);
+
+	if (result != NULL_TREE)
+	  {
+	    // Ensure left-to-right order of evaluation.
+	    if (TREE_SIDE_EFFECTS (t2))
+	      result = compound_expr(t2saved, result);
+
+	    if (TREE_SIDE_EFFECTS (t1))
+	      result = compound_expr(t1saved, result);
+	  }
+	else
+	  {
+	    tree args[3];
+
+	    args[0] = t1saved;
+	    args[1] = t2saved;
+	    args[2] = build_typeinfo(telem->arrayOf());
+	    result = build_libcall(LIBCALL_ADCMP2, 3, args);
+	  }
 
 	// %% For float element types, warn that NaN is not taken into account?
 	// %% Could do a check for side effects and drop the unused condition
@@ -621,6 +731,91 @@ public:
 			      d_build_call_nary(powfn, 2, t1, t2));
   }
 
+  // Lower the chained concatenation E to a single allocation of the
+  // result, with each operand copied in place.  Arrays are copied with
+  // memcpy, and single elements of type ETYPE are stored directly.
+  tree build_cat_inline(CatExp *e, Type *etype)
+  {
+    // Collect the operands from left to right.
+    Expressions operands;
+    Expression *ex = e;
+    for (; ex->op == TOKcat; ex = ((CatExp *) ex)->e1)
+      operands.shift(((CatExp *) ex)->e2);
+    operands.shift(ex);
+
+    // Evaluate all operands once, and sum up their lengths.
+    tree init = NULL_TREE;
+    tree length = size_int(0);
+    vec<tree> values = vNULL;
+    vec<bool> iselem = vNULL;
+
+    for (size_t i = 0; i < operands.dim; i++)
+      {
+	Expression *oe = operands[i];
+	Type *tb = oe->type->toBasetype();
+	bool elem = (tb->ty != Tarray && tb->ty != Tsarray)
+	  || d_types_same(tb, etype->toBasetype());
+	tree value;
+
+	if (elem)
+	  value = d_save_expr(convert_expr(build_expr(oe), oe->type, etype));
+	else
+	  value = d_save_expr(d_array_convert(oe));
+
+	init = compound_expr(init, value);
+	length = size_binop(PLUS_EXPR, length,
+			    elem ? size_int(1) : d_array_length(value));
+	values.safe_push(value);
+	iselem.safe_push(elem);
+      }
+
+    // Allocate the result without initializing it.
+    tree type = build_ctype(e->type);
+    tree result = create_temporary_var(type);
+    tree args[2];
+    args[0] = build_typeinfo(e->type);
+    args[1] = d_save_expr(length);
+    init = compound_expr(init, args[1]);
+    init = compound_expr(init, modify_expr(result,
+					   build_libcall(LIBCALL_NEWARRAYU, 2,
+							 args, type)));
+
+    // Copy each operand into place.
+    tree ptr = d_array_ptr(result);
+    tree etypesize = size_int(etype->size());
+    tree offset = size_int(0);
+    tree copies = NULL_TREE;
+
+    for (size_t i = 0; i < values.length(); i++)
+      {
+	tree dest = build_array_index(ptr, offset);
+
+	if (iselem[i])
+	  {
+	    tree elem = indirect_ref(build_ctype(etype), dest);
+	    copies = compound_expr(copies, modify_expr(elem, values[i]));
+	    offset = size_binop(PLUS_EXPR, offset, size_int(1));
+	  }
+	else
+	  {
+	    tree len = d_array_length(values[i]);
+	    tree copy = d_build_call_nary(builtin_decl_explicit(BUILT_IN_MEMCPY), 3,
+					  dest, d_array_ptr(values[i]),
+					  size_mult_expr(len, etypesize));
+	    copies = compound_expr(copies, copy);
+	    offset = size_binop(PLUS_EXPR, offset, len);
+	  }
+      }
+    values.release();
+    iselem.release();
+
+    // The runtime returns null for an empty result, so skip the copies.
+    tree cond = build_boolop(NE_EXPR, args[1], size_int(0));
+    init = compound_expr(init, build_vcondition(cond, copies, void_node));
+
+    return bind_expr(result, compound_expr(init, result));
+  }
+
   //
   void visit(CatExp *e)
   {
@@ -638,6 +833,16 @@ public:
     vec<tree, va_gc> *elemvars = NULL;
     tree result;
 
+    // Unless optimizing for size, chained concatenations of elements
+    // without postblits are done inline.
+    Type *tbelem = etype->baseElemOf();
+    if (e->e1->op == TOKcat && !optimize_size
+	&& (tbelem->ty != Tstruct || !((TypeStruct *) tbelem)->sym->postblit))
+      {
+	this->result_ = this->build_cat_inline(e, etype);
+	return;
+      }
+
     if (e->e1->op == TOKcat)
       {
 	// Flatten multiple concatenations to an array.
@@ -892,9 +1097,10 @@ public:
 	Type *stype = se->e1->type->toBasetype();
 	Type *etype = stype->nextOf()->toBasetype();
 
-	// Determine if we need to run postblit or dtor.
+	// Determine if we need to run postblit or dtor.  Constructing
+	// elements never destroys the old contents.
 	bool postblit = this->needs_postblit(etype) && this->lvalue_p(e->e2);
-	bool destructor = this->needs_dtor(etype);
+	bool destructor = this->needs_dtor(etype) && e->op != TOKconstruct;
 
 	if (e->memset & blockAssign)
 	  {
@@ -939,18 +1145,49 @@ public:
 	    // Perform a memcpy operation.
 	    gcc_assert(e->e2->type->ty != Tpointer);
 
-	    if (!postblit && !destructor && !array_bounds_check())
+	    if ((!postblit && !destructor) || e->op == TOKblit)
 	      {
 		tree t1 = d_save_expr(d_array_convert(e->e1));
-		tree t2 = d_array_convert(e->e2);
-		tree size = size_mult_expr(d_array_length(t1),
-					   size_int(etype->size()));
+		tree t2 = d_save_expr(d_array_convert(e->e2));
+		tree size = d_save_expr(size_mult_expr(d_array_length(t1),
+						       size_int(etype->size())));
 
 		tree result = d_build_call_nary(builtin_decl_explicit(BUILT_IN_MEMCPY), 3,
 						d_array_ptr(t1), d_array_ptr(t2), size);
+
+		if (array_bounds_check())
+		  {
+		    // Check inline that the lengths match and that the
+		    // arrays don't overlap, only calling _d_arraycopy() to
+		    // raise the error if they do.
+		    tree ptr1 = convert(size_type_node, d_array_ptr(t1));
+		    tree ptr2 = convert(size_type_node, d_array_ptr(t2));
+		    tree diff = build_condition(size_type_node,
+						build_boolop(GT_EXPR, ptr1, ptr2),
+						fold_build2(MINUS_EXPR, size_type_node,
+							    ptr1, ptr2),
+						fold_build2(MINUS_EXPR, size_type_node,
+							    ptr2, ptr1));
+		    tree cond = build_boolop(TRUTH_ORIF_EXPR,
+					     build_boolop(NE_EXPR,
+							  d_array_length(t1),
+							  d_array_length(t2)),
+					     build_boolop(LT_EXPR, diff, size));
+		    tree args[3];
+
+		    args[0] = size_int(etype->size());
+		    args[1] = t2;
+		    args[2] = t1;
+
+		    result = build_vcondition(cond,
+					      build_libcall(LIBCALL_ARRAYCOPY,
+							    3, args),
+					      result);
+		  }
+
 		this->result_ = compound_expr(result, t1);
 	      }
-	    else if ((postblit || destructor) && e->op != TOKblit)
+	    else
 	      {
 		// Generate:
 		//  _d_arrayassign(ti, from, to) or _d_arrayctor(ti, from, to)
@@ -966,18 +1203,6 @@ public:
 		this->result_ = build_libcall(libcall, 3, args,
 					      build_ctype(e->type));
 	      }
-	    else
-	      {
-		// Generate _d_arraycopy()
-		tree args[3];
-
-		args[0] = size_int(etype->size());
-		args[1] = d_save_expr(d_array_convert(e->e2));
-		args[2] = d_array_convert(e->e1);
-
-		this->result_ = build_libcall(LIBCALL_ARRAYCOPY, 3, args,
-					      build_ctype(e->type));
-	      }
 	  }
 
 	return;
@@ -1056,7 +1281,7 @@ public:
 	// Even if the elements in rhs are all rvalues and don't have to call
 	// postblits, this assignment should call dtors on old assigned elements.
 	if ((!postblit && !destructor)
-	    || (e->op == TOKconstruct && !lvalue_p && postblit)
+	    || (e->op == TOKconstruct && (!lvalue_p || !postblit))
 	    || (e->op == TOKblit || e->e1->type->size() == 0))
 	  {
 	    tree t1 = build_expr(e->e1);
@@ -1138,26 +1363,60 @@ public:
 	Type *tkey = ((TypeAArray *) tb1)->index->toBasetype();
 	tree key = convert_expr(build_expr(e->e2), e->e2->type, tkey);
 	LibCall libcall;
-	tree args[4];
+	tree args[5];
+	int nargs;
+
+	// Hash the key inline if the compiler knows how.
+	LibCall equals;
+	key = d_save_expr(key);
+	tree hash = build_aa_key_hash(tkey, key, &equals);
 
-	if (e->modifiable)
+	if (hash != NULL_TREE)
 	  {
-	    libcall = LIBCALL_AAGETY;
-	    args[0] = build_address(build_expr(e->e1));
-	    args[1] = build_typeinfo(tb1->unSharedOf()->mutableOf());
+	    tree fequals = build_address(get_symbol_decl(get_libcall(equals)));
+
+	    if (e->modifiable)
+	      {
+		libcall = LIBCALL_AAGETYH;
+		args[0] = build_address(build_expr(e->e1));
+		args[1] = build_typeinfo(tb1->unSharedOf()->mutableOf());
+		args[2] = build_address(key);
+		args[3] = hash;
+		args[4] = fequals;
+		nargs = 5;
+	      }
+	    else
+	      {
+		libcall = LIBCALL_AAINXH;
+		args[0] = build_expr(e->e1);
+		args[1] = build_address(key);
+		args[2] = hash;
+		args[3] = fequals;
+		nargs = 4;
+	      }
 	  }
 	else
 	  {
-	    libcall = LIBCALL_AAGETRVALUEX;
-	    args[0] = build_expr(e->e1);
-	    args[1] = build_typeinfo(tkey);
-	  }
+	    if (e->modifiable)
+	      {
+		libcall = LIBCALL_AAGETY;
+		args[0] = build_address(build_expr(e->e1));
+		args[1] = build_typeinfo(tb1->unSharedOf()->mutableOf());
+	      }
+	    else
+	      {
+		libcall = LIBCALL_AAGETRVALUEX;
+		args[0] = build_expr(e->e1);
+		args[1] = build_typeinfo(tkey);
+	      }
 
-	args[2] = size_int(tb1->nextOf()->size());
-	args[3] = build_address(key);
+	    args[2] = size_int(tb1->nextOf()->size());
+	    args[3] = build_address(key);
+	    nargs = 4;
+	  }
 
 	// Index the associative array.
-	tree result = build_libcall(libcall, 4, args,
+	tree result = build_libcall(libcall, nargs, args,
 				    build_ctype(e->type->pointerTo()));
 
 	if (!e->indexIsInBounds && array_bounds_check())
@@ -1626,13 +1885,24 @@ public:
 		if (!POINTER_TYPE_P (TREE_TYPE (thisexp)))
 		  thisexp = build_address (thisexp);
 
-		// Make the callee a virtual call.
+		// Make the callee a virtual call, unless the dynamic type of
+		// the object is known, then call its override directly.
 		if (fd->isVirtual () && !fd->isFinalFunc () && !e->directcall)
 		  {
+		    FuncDeclaration *target = resolve_virtual_call (fd, dve->e1);
 		    tree fntype = build_pointer_type (TREE_TYPE (fndecl));
 		    tree thistype = build_ctype (ad->handleType ());
-		    thisexp = build_nop (thistype, d_save_expr (thisexp));
-		    fndecl = build_vindex_ref (thisexp, fntype, fd->vtblIndex);
+
+		    if (target != NULL)
+		      {
+			thisexp = build_nop (thistype, thisexp);
+			fndecl = build_nop (fntype, build_address (get_symbol_decl (target)));
+		      }
+		    else
+		      {
+			thisexp = build_nop (thistype, d_save_expr (thisexp));
+			fndecl = build_vindex_ref (thisexp, fntype, fd->vtblIndex);
+		      }
 		  }
 		else
 		  fndecl = build_address (fndecl);
@@ -1762,13 +2032,21 @@ public:
 
 	fndecl = get_symbol_decl (e->func);
 
-	// Get pointer to function out of the virtual table.
+	// Get pointer to function out of the virtual table, unless the
+	// dynamic type of the object is known.
 	if (e->func->isVirtual() && !e->func->isFinalFunc()
 	    && e->e1->op != TOKsuper && e->e1->op != TOKdottype)
 	  {
+	    FuncDeclaration *target = resolve_virtual_call(e->func, e->e1);
 	    tree fntype = build_pointer_type(TREE_TYPE (fndecl));
-	    object = d_save_expr(object);
-	    fndecl = build_vindex_ref(object, fntype, e->func->vtblIndex);
+
+	    if (target != NULL)
+	      fndecl = build_nop(fntype, build_address(get_symbol_decl (target)));
+	    else
+	      {
+		object = d_save_expr(object);
+		fndecl = build_vindex_ref(object, fntype, e->func->vtblIndex);
+	      }
 	  }
 	else
 	  fndecl = build_address(fndecl);
@@ -2213,12 +2491,7 @@ public:
 	if (e->allocator)
 	  new_call = d_build_call(e->allocator, NULL_TREE, e->newargs);
 	else
-	  {
-	    LibCall libcall = htype->isZeroInit()
-	      ? LIBCALL_NEWITEMT : LIBCALL_NEWITEMIT;
-	    tree arg = build_typeinfo(e->newtype);
-	    new_call = build_libcall(libcall, 1, &arg);
-	  }
+	  new_call = this->build_new_item(e->newtype, e->loc);
 	new_call = build_nop(build_ctype(tb), new_call);
 
 	if (e->member || !e->arguments)
@@ -2273,7 +2546,7 @@ public:
 	  {
 	    // Single dimension array allocations.
 	    Expression *arg = (*e->arguments)[0];
-	    tree args[2];
+	    tree args[3];
 
 	    // Elem size is unknown.
 	    if (tarray->next->size() == 0)
@@ -2283,11 +2556,37 @@ public:
 		return;
 	      }
 
-	    LibCall libcall = tarray->next->isZeroInit()
-	      ? LIBCALL_NEWARRAYT : LIBCALL_NEWARRAYIT;
-	    args[0] = build_typeinfo(e->type);
-	    args[1] = build_expr(arg);
-	    result = build_libcall(libcall, 2, args, build_ctype(tb));
+	    if (!this->new_without_typeinfo_p(tarray->next))
+	      {
+		LibCall libcall = tarray->next->isZeroInit()
+		  ? LIBCALL_NEWARRAYT : LIBCALL_NEWARRAYIT;
+		args[0] = build_typeinfo(e->type);
+		args[1] = build_expr(arg);
+		result = build_libcall(libcall, 2, args, build_ctype(tb));
+	      }
+	    else
+	      {
+		// The element size and block attributes are known, so
+		// the runtime doesn't need the TypeInfo.  Elements with
+		// a non-zero initializer are filled in here.
+		args[0] = build_expr(arg);
+		args[1] = size_int(tarray->next->size());
+		args[2] = this->gc_block_attributes(tarray->next);
+
+		if (tarray->next->isZeroInit())
+		  result = build_libcall(LIBCALL_NEWARRAYN, 3, args,
+					 build_ctype(tb));
+		else
+		  {
+		    result = d_save_expr(build_libcall(LIBCALL_NEWARRAYNU, 3,
+						       args, build_ctype(tb)));
+		    tree init = build_array_set(d_array_ptr(result),
+						d_array_length(result),
+						this->build_new_init(tarray->next,
+								     e->loc));
+		    result = compound_expr(init, result);
+		  }
+	      }
 	  }
 	else
 	  {
@@ -2337,11 +2636,8 @@ public:
 	    return;
 	  }
 
-	LibCall libcall = tpointer->next->isZeroInit(e->loc)
-	  ? LIBCALL_NEWITEMT : LIBCALL_NEWITEMIT;
-
-	tree arg = build_typeinfo(e->newtype);
-	result = build_libcall(libcall, 1, &arg, build_ctype(tb));
+	result = build_nop(build_ctype(tb),
+			   this->build_new_item(e->newtype, e->loc));
 
 	if (e->arguments && e->arguments->dim == 1)
 	  {
@@ -2544,6 +2840,20 @@ public:
 
 	this->result_ = compound_expr(saved_elems, d_convert(type, ctor));
       }
+    else if (e->onstack)
+      {
+	// The literal doesn't escape, so copy it to a stack temporary.
+	tree stack_var = build_local_temp(satype);
+	expand_decl(stack_var);
+
+	tree result = modify_expr(stack_var, ctor);
+	result = compound_expr(result, build_address(stack_var));
+
+	if (tb->ty == Tarray)
+	  result = d_array_value(type, size_int(e->elements->dim), result);
+
+	this->result_ = compound_expr(saved_elems, result);
+      }
     else
       {
 	tree args[2];
@@ -2573,6 +2883,266 @@ public:
       }
   }
 
+  // Return true if KEY, a literal key of type TKEY, can be hashed at compile
+  // time, setting HASH to what TypeInfo.getHash returns for it at run-time.
+
+  static bool aa_literal_key_hash(Expression *key, Type *tkey, dinteger_t *hash)
+  {
+    Type *tb = tkey->toBasetype();
+
+    if (tb->mod & (MODshared | MODwild))
+      return false;
+
+    // The hash of integers up to 32-bits is their value.  TypeInfo_i reads
+    // int keys as uint, so unlike smaller keys they are zero-extended.
+    if (tb->isTypeBasic() && tb->isintegral() && tb->size() <= 4
+	&& key->op == TOKint64)
+      {
+	*hash = key->toInteger();
+	if (tb->size() == 4)
+	  *hash &= 0xffffffff;
+	return true;
+      }
+
+    // The hash of char strings, see TypeInfo_Aa.getHash.
+    if (tb->ty == Tarray && key->op == TOKstring)
+      {
+	Type *tnext = tb->nextOf();
+	StringExp *se = (StringExp *) key;
+
+	if (tnext->ty == Tchar && se->sz == 1
+	    && (tnext->mod == 0 || tnext->mod == MODconst
+		|| tnext->mod == MODimmutable))
+	  {
+	    dinteger_t h = 0;
+	    for (size_t i = 0; i < se->len; i++)
+	      h = h * 11 + ((utf8_t *) se->string)[i];
+
+	    *hash = h;
+	    return true;
+	  }
+      }
+
+    return false;
+  }
+
+  // Return true if the literal keys K1 and K2 hashed above are equal.
+
+  static bool aa_literal_keys_equal(Expression *k1, Expression *k2)
+  {
+    if (k1->op == TOKstring)
+      {
+	StringExp *se1 = (StringExp *) k1;
+	StringExp *se2 = (StringExp *) k2;
+	return se1->len == se2->len
+	  && memcmp(se1->string, se2->string, se1->len) == 0;
+      }
+
+    return k1->toInteger() == k2->toInteger();
+  }
+
+  // Lay out the associative array literal E of type TA in static data, in the
+  // same way as _d_assocarrayliteralTX would build the rt.aaA.Impl struct.
+  // The data is read-only if READONLY.  Returns NULL_TREE if E has keys that
+  // can't be hashed at compile time, or values that aren't constant.
+
+  tree build_static_aa_literal(AssocArrayLiteralExp *e, TypeAArray *ta,
+			       bool readonly)
+  {
+    // Entries are allocated with a fake TypeInfo when values need destroying.
+    Type *tvalue = ta->next->baseElemOf();
+    if (tvalue->ty == Tstruct)
+      {
+	StructDeclaration *sd = ((TypeStruct *) tvalue)->sym;
+	if (sd->dtor || sd->postblit)
+	  return NULL_TREE;
+      }
+
+    // Hashes are computed modulo size_t.
+    unsigned bits = Target::ptrsize * BITS_PER_UNIT;
+    dinteger_t mask = (bits < 64) ? ((dinteger_t) 1 << bits) - 1
+      : ~(dinteger_t) 0;
+
+    // Same number of buckets as the runtime would allocate.
+    size_t length = e->keys->dim;
+    size_t n = 40 * length / 18;
+    size_t dim = 1;
+    while (dim < n)
+      dim <<= 1;
+
+    vec<dinteger_t> hashes = vNULL;
+    vec<int> slots = vNULL;
+    vec<size_t> entries = vNULL;
+    hashes.safe_grow_cleared(dim);
+    slots.safe_grow(dim);
+    for (size_t i = 0; i < dim; i++)
+      slots[i] = -1;
+
+    // Insert the keys into the buckets, later values replacing earlier ones.
+    // Each slot holds an index into ENTRIES, which holds an index into KEYS.
+    tree result = NULL_TREE;
+    for (size_t i = 0; i < length; i++)
+      {
+	Expression *key = (*e->keys)[i];
+	dinteger_t hash;
+
+	if (!aa_literal_key_hash(key, ta->index, &hash))
+	  goto Ldone;
+
+	// mix() and HASH_FILLED_MARK from rt.aaA.
+	hash &= mask;
+	hash ^= hash >> 13;
+	hash = (hash * 0x5bd1e995) & mask;
+	hash ^= hash >> 15;
+	hash |= (dinteger_t) 1 << (bits - 1);
+
+	size_t slot = hash & (dim - 1);
+	for (size_t j = 1; slots[slot] != -1; j++)
+	  {
+	    if (hashes[slot] == hash
+		&& aa_literal_keys_equal((*e->keys)[entries[slots[slot]]], key))
+	      break;
+	    slot = (slot + j) & (dim - 1);
+	  }
+
+	if (slots[slot] == -1)
+	  {
+	    hashes[slot] = hash;
+	    slots[slot] = entries.length();
+	    entries.safe_push(i);
+	  }
+	else
+	  entries[slots[slot]] = i;
+      }
+
+    {
+      // Build the entries, each one being the key followed by the value.
+      tree keytype = build_ctype(ta->index);
+      tree valtype = build_ctype(ta->next);
+      tree entrytype = build_two_field_type(keytype, valtype, NULL,
+					    "key", "value");
+      tree valfield = DECL_CHAIN (TYPE_FIELDS (entrytype));
+      tree entriestype = build_array_type(entrytype,
+					  build_index_type(size_int(entries.length() - 1)));
+
+      vec<constructor_elt, va_gc> *elms = NULL;
+      for (size_t i = 0; i < entries.length(); i++)
+	{
+	  Expression *key = (*e->keys)[entries[i]];
+	  Expression *value = (*e->values)[entries[i]];
+	  tree k = convert_expr(build_expr(key, true), key->type, ta->index);
+	  tree v = convert_expr(build_expr(value, true), value->type, ta->next);
+
+	  if (!initializer_constant_valid_p(k, keytype)
+	      || !initializer_constant_valid_p(v, valtype))
+	    goto Ldone;
+
+	  vec<constructor_elt, va_gc> *ce = NULL;
+	  CONSTRUCTOR_APPEND_ELT (ce, TYPE_FIELDS (entrytype), k);
+	  CONSTRUCTOR_APPEND_ELT (ce, valfield, v);
+	  CONSTRUCTOR_APPEND_ELT (elms, size_int(i),
+				  build_constructor(entrytype, ce));
+	}
+
+      tree entriesdecl = build_artificial_decl(entriestype,
+					       build_constructor(entriestype, elms),
+					       "AAe");
+
+      // Build the buckets, holding the hash and a pointer to the entry.
+      tree buckettype = build_two_field_type(size_type_node, ptr_type_node,
+					     NULL, "hash", "entry");
+      tree bucketstype = build_array_type(buckettype,
+					  build_index_type(size_int(dim - 1)));
+      size_t firstused = dim;
+
+      elms = NULL;
+      for (size_t i = 0; i < dim; i++)
+	{
+	  if (slots[i] == -1)
+	    continue;
+
+	  tree entry = build4(ARRAY_REF, entrytype, entriesdecl,
+			      size_int(slots[i]), NULL_TREE, NULL_TREE);
+	  vec<constructor_elt, va_gc> *ce = NULL;
+	  CONSTRUCTOR_APPEND_ELT (ce, TYPE_FIELDS (buckettype),
+				  build_int_cst(size_type_node, hashes[i]));
+	  CONSTRUCTOR_APPEND_ELT (ce, DECL_CHAIN (TYPE_FIELDS (buckettype)),
+				  convert(ptr_type_node, build_address(entry)));
+	  CONSTRUCTOR_APPEND_ELT (elms, size_int(i),
+				  build_constructor(buckettype, ce));
+
+	  if (firstused == dim)
+	    firstused = i;
+	}
+
+      tree bucketsdecl = build_artificial_decl(bucketstype,
+					       build_constructor(bucketstype, elms),
+					       "AAb");
+
+      // Build the Impl struct, the fields are in the order of rt.aaA.
+      static const char *names[] =
+	{
+	  "buckets_length", "buckets_ptr", "used", "deleted", "entryTI",
+	  "firstUsed", "keysz", "valsz", "valoff", "flags"
+	};
+      tree types[] =
+	{
+	  size_type_node, ptr_type_node, uint_type_node, uint_type_node,
+	  ptr_type_node, uint_type_node, uint_type_node, uint_type_node,
+	  uint_type_node, ubyte_type_node
+	};
+      tree values[] =
+	{
+	  size_int(dim),
+	  convert(ptr_type_node, build_address(bucketsdecl)),
+	  build_int_cst(uint_type_node, entries.length()),
+	  build_int_cst(uint_type_node, 0),
+	  null_pointer_node,
+	  build_int_cst(uint_type_node, firstused),
+	  build_int_cst(uint_type_node, ta->index->size()),
+	  build_int_cst(uint_type_node, ta->next->size()),
+	  build_int_cst(uint_type_node, int_byte_position(valfield)),
+	  // Impl.Flags.hasPointers
+	  build_int_cst(ubyte_type_node,
+			(ta->index->hasPointers() || ta->next->hasPointers())
+			? 2 : 0)
+	};
+
+      tree impltype = make_node(RECORD_TYPE);
+      tree fields = NULL_TREE;
+      vec<constructor_elt, va_gc> *ce = NULL;
+      for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+	{
+	  tree field = create_field_decl(types[i], names[i], 1, 1);
+	  DECL_FIELD_CONTEXT (field) = impltype;
+	  fields = chainon(fields, field);
+	  CONSTRUCTOR_APPEND_ELT (ce, field, values[i]);
+	}
+      TYPE_FIELDS (impltype) = fields;
+      layout_type(impltype);
+
+      tree impldecl = build_artificial_decl(impltype,
+					    build_constructor(impltype, ce),
+					    "AA");
+
+      tree decls[] = { entriesdecl, bucketsdecl, impldecl };
+      for (size_t i = 0; i < 3; i++)
+	{
+	  TREE_READONLY (decls[i]) = readonly;
+	  d_pushdecl(decls[i]);
+	  rest_of_decl_compilation(decls[i], 1, 0);
+	}
+
+      result = build_address(impldecl);
+    }
+
+  Ldone:
+    hashes.release();
+    slots.release();
+    entries.release();
+    return result;
+  }
+
   //
   void visit(AssocArrayLiteralExp *e)
   {
@@ -2588,6 +3158,24 @@ public:
 	return;
       }
 
+    // Literals that can't be modified are laid out at compile time, which
+    // also allows them to be used as static initializers.
+    tree aatype = build_ctype(ta);
+
+    if (e->type->isImmutable() || e->type->isConst())
+      {
+	tree impl = this->build_static_aa_literal(e, ta, true);
+	if (impl != NULL_TREE)
+	  {
+	    tree type = build_ctype(e->type);
+	    vec<constructor_elt, va_gc> *ce = NULL;
+	    CONSTRUCTOR_APPEND_ELT (ce, TYPE_FIELDS (type),
+				    convert(TREE_TYPE (TYPE_FIELDS (type)), impl));
+	    this->result_ = build_constructor(type, ce);
+	    return;
+	  }
+      }
+
     // Build an expression that assigns the expressions in KEYS and VALUES
     // to a constructor.
     vec<constructor_elt, va_gc> *ke = NULL;
@@ -2623,7 +3211,6 @@ public:
     tree mem = build_libcall(LIBCALL_ASSOCARRAYLITERALTX, 3, args);
 
     // Returns an AA pointed to by MEM.
-    tree aatype = build_ctype(ta);
     vec<constructor_elt, va_gc> *ce = NULL;
     CONSTRUCTOR_APPEND_ELT (ce, TYPE_FIELDS (aatype), mem);
 
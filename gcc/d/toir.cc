@@ -26,6 +26,7 @@
 #include "dfrontend/expression.h"
 #include "dfrontend/statement.h"
 #include "dfrontend/visitor.h"
+#include "dfrontend/timetrace.h"
 
 #include "tree.h"
 #include "tree-iterator.h"
@@ -161,6 +162,157 @@ public:
     this->do_label(label);
   }
 
+  // Build an artificial label for the inline string switch lookup.
+  tree build_switch_label()
+  {
+    tree label = build_decl(input_location, LABEL_DECL,
+			    NULL_TREE, void_type_node);
+    DECL_CONTEXT (label) = current_function_decl;
+    DECL_ARTIFICIAL (label) = 1;
+    DECL_MODE (label) = VOIDmode;
+    return label;
+  }
+
+  // Emit the code setting INDEX to the index of the case in CASES that
+  // matches the string at PTR, then jumping to DONE.  All CASES have
+  // LENGTH characters.  Cases are told apart by switching on the character
+  // at the position with the most distinct values, until only one is left,
+  // which is then compared in full.
+  void build_string_lookup(vec<CaseStatement *> cases, size_t length,
+			   tree ptr, tree index, tree done)
+  {
+    if (cases.length() == 1)
+      {
+	CaseStatement *cs = cases[0];
+	tree match = modify_expr(index, build_integer_cst(cs->index,
+							  TREE_TYPE (index)));
+	if (length != 0)
+	  {
+	    StringExp *se = (StringExp *) cs->exp;
+	    tree cmp = d_build_call_nary(builtin_decl_explicit(BUILT_IN_MEMCMP), 3,
+					 ptr, d_array_ptr(build_expr(se)),
+					 size_int(length * se->sz));
+	    match = build_vcondition(build_boolop(EQ_EXPR, cmp, integer_zero_node),
+				     match, void_node);
+	  }
+	add_stmt(match);
+	add_stmt(fold_build1(GOTO_EXPR, void_type_node, done));
+	return;
+      }
+
+    // Pick the position that splits the cases into the most groups.
+    size_t pos = 0;
+    size_t best = 0;
+    for (size_t i = 0; i < length; i++)
+      {
+	size_t distinct = 0;
+	for (size_t j = 0; j < cases.length(); j++)
+	  {
+	    unsigned c = ((StringExp *) cases[j]->exp)->charAt(i);
+	    size_t k;
+	    for (k = 0; k < j; k++)
+	      {
+		if (((StringExp *) cases[k]->exp)->charAt(i) == c)
+		  break;
+	      }
+	    if (k == j)
+	      distinct++;
+	  }
+
+	if (distinct > best)
+	  {
+	    pos = i;
+	    best = distinct;
+	  }
+      }
+
+    // Order the cases by the character at that position.
+    for (size_t i = 1; i < cases.length(); i++)
+      {
+	CaseStatement *cs = cases[i];
+	unsigned c = ((StringExp *) cs->exp)->charAt(pos);
+	size_t j = i;
+	for (; j > 0 && ((StringExp *) cases[j - 1]->exp)->charAt(pos) > c; j--)
+	  cases[j] = cases[j - 1];
+	cases[j] = cs;
+      }
+
+    tree etype = TREE_TYPE (TREE_TYPE (ptr));
+    tree chr = indirect_ref(etype, build_array_index(ptr, size_int(pos)));
+
+    push_stmt_list();
+    for (size_t i = 0; i < cases.length(); )
+      {
+	unsigned c = ((StringExp *) cases[i]->exp)->charAt(pos);
+	vec<CaseStatement *> group = vNULL;
+
+	for (; i < cases.length(); i++)
+	  {
+	    if (((StringExp *) cases[i]->exp)->charAt(pos) != c)
+	      break;
+	    group.safe_push(cases[i]);
+	  }
+
+	add_stmt(build_case_label(build_integer_cst(c, etype), NULL_TREE,
+				  this->build_switch_label()));
+	this->build_string_lookup(group, length, ptr, index, done);
+	group.release();
+      }
+
+    add_stmt(build_case_label(NULL_TREE, NULL_TREE, this->build_switch_label()));
+    add_stmt(fold_build1(GOTO_EXPR, void_type_node, done));
+
+    tree body = pop_stmt_list();
+    add_stmt(build3(SWITCH_EXPR, etype, chr, body, NULL_TREE));
+  }
+
+  // Lower the lookup of the string CONDITION in the cases of switch S
+  // to a switch on the length, followed by switches on the characters.
+  // Returns the index of the matching case, or -1 if there is none,
+  // the same as the _d_switch_string library functions.
+  tree build_string_switch(SwitchStatement *s, tree condition)
+  {
+    tree value = build_local_temp(TREE_TYPE (condition));
+    add_stmt(modify_expr(value, condition));
+
+    tree index = build_local_temp(build_ctype(Type::tint32));
+    add_stmt(modify_expr(index, build_integer_cst(-1, TREE_TYPE (index))));
+
+    tree length = d_array_length(value);
+    tree ptr = d_array_ptr(value);
+    tree done = this->build_switch_label();
+
+    // Cases are sorted by length first.
+    push_stmt_list();
+    for (size_t i = 0; i < s->cases->dim; )
+      {
+	size_t len = ((StringExp *) (*s->cases)[i]->exp)->len;
+	vec<CaseStatement *> group = vNULL;
+
+	for (; i < s->cases->dim; i++)
+	  {
+	    CaseStatement *cs = (*s->cases)[i];
+	    if (((StringExp *) cs->exp)->len != len)
+	      break;
+	    group.safe_push(cs);
+	  }
+
+	add_stmt(build_case_label(build_integer_cst(len, TREE_TYPE (length)),
+				  NULL_TREE, this->build_switch_label()));
+	this->build_string_lookup(group, len, ptr, index, done);
+	group.release();
+      }
+
+    add_stmt(build_case_label(NULL_TREE, NULL_TREE, this->build_switch_label()));
+    add_stmt(fold_build1(GOTO_EXPR, void_type_node, done));
+
+    tree body = pop_stmt_list();
+    add_stmt(build3(SWITCH_EXPR, TREE_TYPE (length), length, body, NULL_TREE));
+    add_stmt(build1(LABEL_EXPR, void_type_node, done));
+
+    return index;
+  }
+
 
   // Visitor interfaces.
 
@@ -433,6 +585,7 @@ public:
 	// on the case array, have to change them to be useable.
 	Type *satype = condtype->sarrayOf(s->cases->dim);
 	vec<constructor_elt, va_gc> *elms = NULL;
+	bool literals = true;
 
 	s->cases->sort();
 
@@ -442,7 +595,10 @@ public:
 	    cs->index = i;
 
 	    if (cs->exp->op != TOKstring)
-	      s->error("case '%s' is not a string", cs->exp->toChars());
+	      {
+		s->error("case '%s' is not a string", cs->exp->toChars());
+		literals = false;
+	      }
 	    else
 	      {
 		tree exp = build_expr(cs->exp, true);
@@ -450,20 +606,27 @@ public:
 	      }
 	  }
 
-	// Build static declaration to reference constructor.
-	tree ctor = build_constructor(build_ctype(satype), elms);
-	tree decl = build_artificial_decl(TREE_TYPE (ctor), ctor);
-	TREE_READONLY (decl) = 1;
-	d_pushdecl(decl);
-	rest_of_decl_compilation(decl, 1, 0);
-
-	tree args[2];
-	args[0] = d_array_value(build_ctype(condtype->arrayOf()),
-				size_int(s->cases->dim),
-				build_address(decl));
-	args[1] = condition;
-
-	condition = build_libcall(libcall, 2, args);
+	// Unless optimizing for size, look up the case index inline,
+	// instead of doing a binary search in the library.
+	if (literals && !optimize_size)
+	  condition = this->build_string_switch(s, condition);
+	else
+	  {
+	    // Build static declaration to reference constructor.
+	    tree ctor = build_constructor(build_ctype(satype), elms);
+	    tree decl = build_artificial_decl(TREE_TYPE (ctor), ctor);
+	    TREE_READONLY (decl) = 1;
+	    d_pushdecl(decl);
+	    rest_of_decl_compilation(decl, 1, 0);
+
+	    tree args[2];
+	    args[0] = d_array_value(build_ctype(condtype->arrayOf()),
+				    size_int(s->cases->dim),
+				    build_address(decl));
+	    args[1] = condition;
+
+	    condition = build_libcall(libcall, 2, args);
+	  }
       }
     else if (!condtype->isscalar())
       {
@@ -1054,6 +1217,7 @@ public:
 void
 build_ir(FuncDeclaration *fd)
 {
+  TimeTraceScope trace ("Codegen function", fd);
   IRVisitor v = IRVisitor(fd);
   fd->fbody->accept(&v);
 }
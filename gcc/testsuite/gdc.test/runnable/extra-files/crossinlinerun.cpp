@@ -0,0 +1,7 @@
+// Only here so that the D sources of crossinlinerun.d are compiled
+// one at a time, as the driver compiles them together otherwise.
+
+extern "C" int crossinlinerun_cpp()
+{
+    return 0;
+}